@@ -38,6 +38,15 @@ BOOST_STATIC_ASSERT(A3_MEMORY_CTL_NUM != 0);
 
 namespace interprocess = boost::interprocess;
 
+// spin wait hint
+inline void cpu_relax() {
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__("pause" ::: "memory");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
 class command {
  public:
     enum type_t {
@@ -45,7 +54,9 @@ class command {
         TYPE_WRITE,
         TYPE_READ,
         TYPE_UTILITY,
-        TYPE_BAR3
+        TYPE_BAR3,
+        TYPE_BATCH,
+        TYPE_BAR1
     };
 
     enum bar_t {
@@ -58,13 +69,17 @@ class command {
     enum utility_t {
         UTILITY_PGRAPH_STATUS = 0,
         UTILITY_REGISTER_READ,
-        UTILITY_CLEAR_SHADOWING_UTILIZATION
+        UTILITY_CLEAR_SHADOWING_UTILIZATION,
+        UTILITY_TRACE,
+        UTILITY_LOCK_STATISTICS,
+        UTILITY_PMEM_STATISTICS,
+        UTILITY_P2M_INVALIDATE
     };
 
     uint32_t type;
     uint32_t value;
     uint32_t offset;
-    uint8_t  u8[4];
+    uint8_t  u8[4];  // bar, size
 
     inline bar_t bar() const { return static_cast<bar_t>(u8[0]); }
     inline std::size_t size() const { return u8[1]; }
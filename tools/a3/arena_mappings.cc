@@ -0,0 +1,136 @@
+/*
+ * A3 arena Xen mappings
+ *
+ * Copyright (c) 2012-2013 Yusuke Suzuki
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <cerrno>
+#include <cinttypes>
+#include <algorithm>
+#include "a3.h"
+#include "arena_mappings.h"
+#include "context.h"
+#include "device.h"
+#include "flags.h"
+#include "page_table.h"
+namespace a3 {
+
+arena_mappings_t::arena_mappings_t(const char* name, bool enabled, uint64_t address, uint64_t arena_pages, uint64_t pages)
+    : name_(name)
+    , enabled_(enabled)
+    , address_(address)
+    , arena_pages_(arena_pages)
+    , read_only_(a3::flags::barrier_read_only)
+    , mappings_(pages, A3_XEN_UNMAPPED)
+    , pending_()
+    , previous_()
+{
+}
+
+uint64_t arena_mappings_t::host(context* ctx) const {
+    return (address_ >> kPAGE_SHIFT) + ctx->id() * arena_pages_;
+}
+
+void arena_mappings_t::map(context* ctx, uint64_t guest, uint64_t index, uint64_t count, a3_xen_mapping_t mapping) {
+    if (!enabled_) {
+        return;
+    }
+    if (mapping == A3_XEN_READ_ONLY && !read_only_) {
+        mapping = A3_XEN_UNMAPPED;
+    }
+    const uint64_t shift = ctx->id() * arena_pages_;
+    const uint64_t first = guest >> kPAGE_SHIFT;
+    const uint64_t host = this->host(ctx);
+    for (const uint64_t last = index + count; index < last; ++index) {
+        const a3_xen_mapping_t previous = mappings_[shift + index];
+        if (previous == mapping) {
+            continue;
+        }
+        mappings_[shift + index] = mapping;
+        if (!pending_.empty()) {
+            a3_xen_memory_mapping_t& extent = pending_.back();
+            if (extent.mapping == mapping &&
+                previous_.back() == previous &&
+                extent.first_gfn + extent.nr_mfns == first + index &&
+                extent.first_mfn + extent.nr_mfns == host + index) {
+                ++extent.nr_mfns;
+                continue;
+            }
+        }
+        const a3_xen_memory_mapping_t extent = { first + index, host + index, 1, mapping };
+        pending_.push_back(extent);
+        previous_.push_back(previous);
+    }
+}
+
+void arena_mappings_t::flush(context* ctx) {
+    if (pending_.empty()) {
+        return;
+    }
+    A3_LOG("%s batch mapping %" PRIu64 " extents\n", name_, static_cast<uint64_t>(pending_.size()));
+    const uint64_t shift = ctx->id() * arena_pages_;
+    const uint64_t host = this->host(ctx);
+    std::size_t first = 0;
+    while (first < pending_.size()) {
+        unsigned long done = 0;
+        int ret = 0;
+        A3_SYNCHRONIZED(device()->xen_mutex()) {
+            ret = a3_xen_memory_mapping_batch(device()->xl_ctx(), ctx->domid(), pending_.data() + first, pending_.size() - first, &done);
+        }
+        first += done;
+        if (ret == 0 || first == pending_.size()) {
+            break;
+        }
+
+        a3_xen_memory_mapping_t& failed = pending_[first];
+        if (read_only_ && failed.mapping == A3_XEN_READ_ONLY && (ret == -EOPNOTSUPP || ret == -EINVAL)) {
+            // The hypervisor has no read-only MMIO mapping. Trap barrier
+            // pages entirely from now and apply the rest again.
+            A3_LOG("%s read-only mapping is not supported, trapping barrier reads\n", name_);
+            read_only_ = false;
+            for (std::size_t i = first; i < pending_.size(); ++i) {
+                a3_xen_memory_mapping_t& extent = pending_[i];
+                if (extent.mapping == A3_XEN_READ_ONLY) {
+                    extent.mapping = A3_XEN_UNMAPPED;
+                    std::fill_n(mappings_.begin() + shift + (extent.first_mfn - host), extent.nr_mfns, A3_XEN_UNMAPPED);
+                }
+            }
+            continue;
+        }
+
+        // the failing extent is removed again by libxc, the rest is untouched
+        A3_LOG("%s batch mapping failed %d\n", name_, ret);
+        std::fill_n(mappings_.begin() + shift + (failed.first_mfn - host), failed.nr_mfns, A3_XEN_UNMAPPED);
+        for (std::size_t i = first + 1; i < pending_.size(); ++i) {
+            const a3_xen_memory_mapping_t& extent = pending_[i];
+            std::fill_n(mappings_.begin() + shift + (extent.first_mfn - host), extent.nr_mfns, previous_[i]);
+        }
+        break;
+    }
+    pending_.clear();
+    previous_.clear();
+}
+
+void arena_mappings_t::release(uint32_t id) {
+    std::fill_n(mappings_.begin() + id * arena_pages_, arena_pages_, A3_XEN_UNMAPPED);
+}
+
+}  // namespace a3
+/* vim: set sw=4 ts=4 et tw=80 : */
@@ -0,0 +1,40 @@
+#ifndef A3_ARENA_MAPPINGS_H_
+#define A3_ARENA_MAPPINGS_H_
+#include <cstdint>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include "xen.h"
+namespace a3 {
+
+class context;
+
+// Xen mappings of the per VM arena pages of a BAR into the guest BAR.
+// map() queues changes, skipping pages already in that state and merging
+// contiguous ones into extents. flush() issues the queue with vectored
+// memory_mapping calls and rolls the state back for extents which failed, so
+// the next remap of those pages tries again. Callers hold the BAR mutex.
+class arena_mappings_t : private boost::noncopyable {
+ public:
+    arena_mappings_t(const char* name, bool enabled, uint64_t address, uint64_t arena_pages, uint64_t pages);
+    // arena pages [index, index + count) of ctx, the guest BAR starts at guest
+    void map(context* ctx, uint64_t guest, uint64_t index, uint64_t count, a3_xen_mapping_t mapping);
+    void flush(context* ctx);
+    // the Xen mappings go away with the domain
+    void release(uint32_t id);
+
+ private:
+    uint64_t host(context* ctx) const;
+
+    const char* name_;
+    bool enabled_;
+    uint64_t address_;  // host address of the arena of VM 0
+    uint64_t arena_pages_;
+    bool read_only_;  // cleared when the hypervisor rejects read-only mappings
+    std::vector<a3_xen_mapping_t> mappings_;  // per arena page
+    std::vector<a3_xen_memory_mapping_t> pending_;
+    std::vector<a3_xen_mapping_t> previous_;  // per pending extent, for rollback
+};
+
+}  // namespace a3
+#endif  // A3_ARENA_MAPPINGS_H_
+/* vim: set sw=4 ts=4 et tw=80 : */
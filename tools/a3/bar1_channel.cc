@@ -53,19 +53,27 @@ void bar1_channel_t::shadow(context* ctx) {
         return;
     }
 
-    pmem::accessor pmem;
-    // and adjust address
-    // page directory
-    uint64_t page_directory_virt = mmio::read64(&pmem, ramin_address() + 0x0200);
-    uint64_t page_directory_phys = ctx->get_phys_address(page_directory_virt);
-    uint64_t page_directory_size = mmio::read64(&pmem, ramin_address() + 0x0208);
-    table()->refresh(ctx, page_directory_phys, page_directory_size);
+    {
+        pmem::accessor pmem;
+        // and adjust address
+        // page directory
+        uint64_t page_directory_virt = mmio::read64(&pmem, ramin_address() + 0x0200);
+        uint64_t page_directory_phys = ctx->get_phys_address(page_directory_virt);
+        uint64_t page_directory_size = mmio::read64(&pmem, ramin_address() + 0x0208);
+        table()->refresh(ctx, page_directory_phys, page_directory_size);
+        ctx->bar1_tlb()->invalidate();
+    }
+
+    A3_SYNCHRONIZED(device()->bar1()->mutex()) {
+        device()->bar1()->remap(ctx);
+    }
 }
 
 void bar1_channel_t::attach(context* ctx, uint64_t addr) {
     A3_LOG("attach to 0x%" PRIX64 "\n", ramin_address());
-    shadow(ctx);
+    // map the barrier first, so that remapping keeps RAMIN trapped
     ctx->barrier()->map(ramin_address());
+    shadow(ctx);
 }
 
 void bar1_channel_t::refresh(context* ctx, uint64_t addr) {
@@ -55,17 +55,21 @@ void bar3_channel_t::shadow(context* ctx) {
         return;
     }
 
-    pmem::accessor pmem;
     // and adjust address
     // page directory
-    uint64_t page_directory_virt = mmio::read64(&pmem, ramin_address() + 0x0200);
+    uint64_t page_directory_virt = 0;
+    {
+        // released before taking the BAR3 lock
+        pmem::accessor pmem;
+        page_directory_virt = mmio::read64(&pmem, ramin_address() + 0x0200);
+    }
     uint64_t page_directory_phys = ctx->get_phys_address(page_directory_virt);
     refresh_table(ctx, page_directory_phys);
 }
 
 void bar3_channel_t::refresh_table(context* ctx, uint64_t addr) {
     page_directory_address_ = addr;
-    A3_SYNCHRONIZED(device()->mutex()) {
+    A3_SYNCHRONIZED(device()->bar3()->mutex()) {
         device()->bar3()->refresh_table(ctx, addr);
     }
 }
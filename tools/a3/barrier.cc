@@ -30,39 +30,57 @@ namespace barrier {
 
 table::table(uint64_t base, uint64_t memory_size)
     : table_()
+    , present_()
     , base_(base)
-    , size_(bit_mask<kADDRESS_BITS>(memory_size)) {
+    , size_(bit_mask<kADDRESS_BITS>(memory_size))
+    , generation_(0) {
     if (memory_size == 0) {
         return;
     }
     const uint32_t directories_size = bit_mask<kPAGE_DIRECTORY_BITS>((size_ - 1) >> (kPAGE_BITS + kPAGE_DIRECTORY_BITS)) + 1;
     table_.resize(directories_size);
+    present_.resize(((size_ >> kPAGE_BITS) + 63) / 64);
 }
 
-bool table::in_range(uint64_t address) const {
-    return base() <= address && address < (base() + size());
+void table::update_present(uint64_t address, const page_entry* entry) {
+    const uint64_t page = (address - base()) >> kPAGE_BITS;
+    const uint64_t bit = 0x1ULL << (page % 64);
+    if (entry->present()) {
+        present_[page / 64] |= bit;
+    } else {
+        present_[page / 64] &= ~bit;
+    }
 }
 
 bool table::map(uint64_t page_start_address) {
+    ++generation_;
     page_entry* entry = nullptr;
     const bool result = lookup(page_start_address, &entry, true);
     if (entry) {
         entry->retain();
+        update_present(page_start_address, entry);
     }
     return result;
 }
 
 bool table::unmap(uint64_t page_start_address) {
+    ++generation_;
     page_entry* entry = nullptr;
     lookup(page_start_address, &entry, false);
     if (entry) {
         entry->release();
+        update_present(page_start_address, entry);
         return entry->present();
     }
     return false;
 }
 
 bool table::lookup(uint64_t address, page_entry** entry, bool force_create) {
+    // absent pages are answered by the bitmap
+    if (!force_create && !contains(address)) {
+        return false;
+    }
+
     // out of range
     if (!in_range(address)) {
         return false;
@@ -4,7 +4,7 @@
 #include <cstdio>
 #include <vector>
 #include <array>
-#include <boost/shared_ptr.hpp>
+#include <memory>
 #include <boost/static_assert.hpp>
 namespace a3 {
 namespace barrier {
@@ -52,21 +52,38 @@ class page_directory {
 
 class table {
  public:
-    typedef boost::shared_ptr<page_directory> directory;
+    typedef std::unique_ptr<page_directory> directory;
     table(uint64_t base, uint64_t size);
     // returns previous definition exists
     bool map(uint64_t page_start_address);
     bool unmap(uint64_t page_start_address);
     bool lookup(uint64_t address, page_entry** entry, bool force_create = true);
+
+    // whether the page of address is a barrier, a single bit test
+    bool contains(uint64_t address) const {
+        if (!in_range(address)) {
+            return false;
+        }
+        const uint64_t page = (address - base()) >> kPAGE_BITS;
+        return (present_[page / 64] >> (page % 64)) & 0x1;
+    }
+
     uint64_t base() const { return base_; }
     uint64_t size() const { return size_; }
+    // incremented on every map / unmap
+    uint64_t generation() const { return generation_; }
 
  private:
-    bool in_range(uint64_t address) const;
+    bool in_range(uint64_t address) const {
+        return base() <= address && address < (base() + size());
+    }
+    void update_present(uint64_t address, const page_entry* entry);
 
     std::vector<directory> table_;
+    std::vector<uint64_t> present_;  // 1 bit per page, mirrors the ref counts
     uint64_t base_;
     uint64_t size_;
+    uint64_t generation_;
 };
 
 } }  // namespace a3::barrier
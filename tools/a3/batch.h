@@ -0,0 +1,59 @@
+#ifndef A3_BATCH_H_
+#define A3_BATCH_H_
+#include <cstdint>
+#include <atomic>
+#include "a3.h"
+#include "ring.h"
+namespace a3 {
+
+// Posted writes are buffered by the device model into the shared batch area
+// and handed to A3 by one TYPE_BATCH command. TYPE_BATCH carries the number of
+// entries in value and the batch sequence number in offset. The batch buffer
+// is selected by the sequence number, and A3 publishes the number of consumed
+// batches, so the device model can fill the next buffer while A3 is still
+// handling the previous one. When A3 is behind, the device model sleeps on
+// consumed with futex, as the ring does.
+struct batch_area_t {
+    static const uint32_t kBUFFERS = 2;
+    static const uint32_t kENTRIES = 1024;
+
+    batch_area_t() : consumed(0), waiters(0) { }
+
+    command* buffer(uint32_t seq) { return entries[seq % kBUFFERS]; }
+
+    // the device model should not fill batch seq until this returns true
+    bool writable(uint32_t seq) const {
+        return writable(consumed.load(std::memory_order_acquire), seq);
+    }
+
+    void wait_writable(uint32_t seq) {
+        waiters.fetch_add(1, std::memory_order_seq_cst);
+        uint32_t current;
+        while (!writable(current = consumed.load(std::memory_order_seq_cst), seq)) {
+            ring_detail::futex_wait(&consumed, current);
+        }
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // called by A3 when batch seq is handled
+    void consume(uint32_t seq) {
+        consumed.store(seq + 1, std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_seq_cst)) {
+            ring_detail::futex_wake(&consumed);
+        }
+    }
+
+    static bool writable(uint32_t consumed, uint32_t seq) {
+        return static_cast<int32_t>(consumed + kBUFFERS - seq) > 0;
+    }
+
+    std::atomic<uint32_t> consumed;
+    char pad0_[kCACHE_LINE_SIZE - sizeof(std::atomic<uint32_t>)];
+    std::atomic<uint32_t> waiters;
+    char pad1_[kCACHE_LINE_SIZE - sizeof(std::atomic<uint32_t>)];
+    command entries[kBUFFERS][kENTRIES];
+};
+
+}  // namespace a3
+#endif  // A3_BATCH_H_
+/* vim: set sw=4 ts=4 et tw=80 : */
@@ -21,6 +21,7 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
  */
+#include <array>
 #include <cstdio>
 #include <cinttypes>
 #include <utility>
@@ -34,6 +35,7 @@
 #include "page.h"
 #include "pv_page.h"
 #include "bit_mask.h"
+#include "device_bar1.h"
 #include "device_bar3.h"
 #include "mmio.h"
 #include "timer.h"
@@ -46,7 +48,8 @@ channel::channel(int id)
     , tlb_flush_needed_(false)
     , ramin_address_()
     , shared_address_()
-    , table_(new shadow_page_table(id))
+    , table_(nullptr)
+    , table_directory_()
     , shadow_ramin_(new page(1))
     , original_(A3_DOMAIN_CHANNELS)
     , derived_(&original_)
@@ -58,7 +61,7 @@ bool channel::detach(context* ctx, uint64_t addr) {
     const bool old_exists = ctx->barrier()->unmap(ramin_address());
 
     typedef context::channel_map::iterator iter_t;
-    const std::pair<iter_t, iter_t> range = ctx->ramin_channel_map()->equal_range(addr);
+    const std::pair<iter_t, iter_t> range = ctx->ramin_channel_map()->equal_range(ramin_address());
     for (iter_t it = range.first; it != range.second; ++it) {
         if (it->second == this) {
             ctx->ramin_channel_map()->erase(it);
@@ -74,44 +77,50 @@ void channel::shadow(context* ctx) {
     uint64_t page_directory_phys = 0;
     uint64_t page_directory_size = 0;
 
-    pmem::accessor pmem;
+    // guest RAMIN is read under pmem, which is released before refreshing
+    // the shadow page table on the workers
+    {
+        pmem::accessor pmem;
 
-    // shadow ramin
-    for (uint64_t offset = 0; offset < 0x1000; offset += 0x4) {
-        const uint32_t value = pmem.read32(ramin_address() + offset);
-        shadow_ramin()->write32(offset, value);
-    }
+        // shadow ramin
+        std::array<uint32_t, 0x1000 / sizeof(uint32_t)> ramin;
+        for (uint64_t offset = 0; offset < 0x1000; offset += 0x4) {
+            ramin[offset / sizeof(uint32_t)] = pmem.read32(ramin_address() + offset);
+        }
+        shadow_ramin()->write_block(0, ramin.data(), 0x1000);
 
-    // and adjust address
-    // page directory
+        // and adjust address
+        // page directory
 
-    if (!ctx->para_virtualized()) {
-        page_directory_virt = mmio::read64(&pmem, ramin_address() + 0x0200);
-        page_directory_phys = ctx->get_phys_address(page_directory_virt);
-        page_directory_size = mmio::read64(&pmem, ramin_address() + 0x0208);
-        mmio::write64(shadow_ramin(), 0x0200, page_directory_phys);
-        mmio::write64(shadow_ramin(), 0x0208, page_directory_size);
+        if (!ctx->para_virtualized()) {
+            page_directory_virt = mmio::read64(&pmem, ramin_address() + 0x0200);
+            page_directory_phys = ctx->get_phys_address(page_directory_virt);
+            page_directory_size = mmio::read64(&pmem, ramin_address() + 0x0208);
+            mmio::write64(shadow_ramin(), 0x0200, page_directory_phys);
+            mmio::write64(shadow_ramin(), 0x0208, page_directory_size);
 
-        A3_LOG("id %d virt 0x%" PRIX64 " phys 0x%" PRIX64 " size %" PRIu64 "\n", id(), page_directory_virt, page_directory_phys, page_directory_size);
-    }
+            A3_LOG("id %d virt 0x%" PRIX64 " phys 0x%" PRIX64 " size %" PRIu64 "\n", id(), page_directory_virt, page_directory_phys, page_directory_size);
+        }
 
-    // fctx
-    const uint64_t fctx_virt = mmio::read64(&pmem, ramin_address() + 0x08);
-    const uint64_t fctx_phys = ctx->get_phys_address(fctx_virt);
-    mmio::write64(shadow_ramin(), 0x08, fctx_phys);
+        // fctx
+        const uint64_t fctx_virt = mmio::read64(&pmem, ramin_address() + 0x08);
+        const uint64_t fctx_phys = ctx->get_phys_address(fctx_virt);
+        mmio::write64(shadow_ramin(), 0x08, fctx_phys);
 
-    // mpeg ctx
-    const uint64_t mpeg_ctx_limit_virt = pmem.read32(ramin_address() + 0x60 + 0x04);
-    const uint64_t mpeg_ctx_limit_phys = ctx->get_phys_address(mpeg_ctx_limit_virt);
-    shadow_ramin()->write32(0x60 + 0x04, mpeg_ctx_limit_phys);
+        // mpeg ctx
+        const uint64_t mpeg_ctx_limit_virt = pmem.read32(ramin_address() + 0x60 + 0x04);
+        const uint64_t mpeg_ctx_limit_phys = ctx->get_phys_address(mpeg_ctx_limit_virt);
+        shadow_ramin()->write32(0x60 + 0x04, mpeg_ctx_limit_phys);
 
-    const uint64_t mpeg_ctx_virt = pmem.read32(ramin_address() + 0x60 + 0x08);
-    const uint64_t mpeg_ctx_phys = ctx->get_phys_address(mpeg_ctx_virt);
-    shadow_ramin()->write32(0x60 + 0x08, mpeg_ctx_phys);
+        const uint64_t mpeg_ctx_virt = pmem.read32(ramin_address() + 0x60 + 0x08);
+        const uint64_t mpeg_ctx_phys = ctx->get_phys_address(mpeg_ctx_virt);
+        shadow_ramin()->write32(0x60 + 0x08, mpeg_ctx_phys);
+    }
 
     // TODO(Yusuke Suzuki):
     // optimize it. only mark it is OK or NG
     if (!ctx->para_virtualized()) {
+        bind_table(ctx, page_directory_phys);
         table()->refresh(ctx, page_directory_phys, page_directory_size);
         write_shadow_page_table(ctx, table()->shadow_address());
     } else {
@@ -135,6 +144,56 @@ void channel::shadow(context* ctx) {
     }
 }
 
+void channel::bind_table(context* ctx, uint64_t page_directory) {
+    if (table_ && table_directory_ == page_directory) {
+        return;
+    }
+    shadow_page_table* table = ctx->shadow_cache()->acquire(page_directory, id());
+    if (table_) {
+        ctx->shadow_cache()->release(table_directory_);
+    }
+    table_ = table;
+    table_directory_ = page_directory;
+}
+
+void channel::release_table(context* ctx) {
+    if (!table_) {
+        return;
+    }
+    ctx->shadow_cache()->release(table_directory_);
+    table_ = nullptr;
+    table_directory_ = 0;
+}
+
+// RAMIN of the unbound channel is not a barrier any more, and its shadow page
+// table becomes idle, so the shadow cache can evict it.
+void channel::disable(context* ctx) {
+    if (!enabled()) {
+        return;
+    }
+    A3_LOG("disable channel %d with 0x%" PRIX64 "\n", id(), ramin_address());
+    detach(ctx, ramin_address());
+    ctx->barrier_changed(ramin_address());
+
+    // channels sharing the shadow of this one take their own again
+    if (is_overridden_shadow()) {
+        derived_->set(id(), false);
+        derived_ = &original_;
+    } else {
+        const page_table_reuse_t derived(original_);
+        for (page_table_reuse_t::size_type pos = derived.find_first(); pos != derived.npos; pos = derived.find_next(pos)) {
+            if (static_cast<int>(pos) != id()) {
+                ctx->channels(pos)->remove_overridden_shadow(ctx);
+            }
+        }
+    }
+    generate_original();
+
+    release_table(ctx);
+    enabled_ = false;
+    tlb_flush_needed_ = false;
+}
+
 void channel::write_shadow_page_table(context* ctx, uint64_t shadow) {
     mmio::write64(shadow_ramin(), 0x0200, shadow);
 }
@@ -159,7 +218,10 @@ uint64_t channel::refresh(context* ctx, uint64_t addr) {
     const uint64_t old = ramin_address_;
     ramin_address_ = addr;
     attach(ctx, addr);
-    A3_SYNCHRONIZED(device()->mutex()) {
+    A3_SYNCHRONIZED(device()->bar1()->mutex()) {
+        device()->bar1()->reset_barrier(ctx, old, addr);
+    }
+    A3_SYNCHRONIZED(device()->bar3()->mutex()) {
         device()->bar3()->reset_barrier(ctx, old, addr, old_remap);
     }
     return shadow_ramin()->address();
@@ -186,7 +248,7 @@ void channel::tlb_flush_needed() {
 }
 
 void channel::flush(context* ctx) {
-    if (!tlb_flush_needed_) {
+    if (!tlb_flush_needed_ || !table_) {
         return;
     }
 
@@ -15,14 +15,19 @@ class channel : private boost::noncopyable {
 
     channel(int id);
     uint64_t refresh(context* ctx, uint64_t addr);
-    shadow_page_table* table() { return table_.get(); }
-    const shadow_page_table* table() const { return table_.get(); }
+    // nullptr until the channel is shadowed
+    shadow_page_table* table() { return table_; }
+    const shadow_page_table* table() const { return table_; }
     int id() const { return id_; }
     bool enabled() const { return enabled_; }
     uint64_t ramin_address() const { return ramin_address_; }
     page* shadow_ramin() { return shadow_ramin_.get(); }
     const page* shadow_ramin() const { return shadow_ramin_.get(); }
     void shadow(context* ctx);
+    // the guest unbound the channel
+    void disable(context* ctx);
+    // gives the shadow page table back to the context shadow cache
+    void release_table(context* ctx);
 
     void flush(context* ctx);
     void tlb_flush_needed();
@@ -49,6 +54,7 @@ class channel : private boost::noncopyable {
         tlb_flush_needed_ = false;
     }
     bool detach(context* ctx, uint64_t addr);
+    void bind_table(context* ctx, uint64_t page_directory);
     void attach(context* ctx, uint64_t addr);
     int id_;
     bool enabled_;
@@ -56,7 +62,8 @@ class channel : private boost::noncopyable {
     uint64_t ramin_address_;
     uint64_t shared_address_;
     uint32_t submitted_;
-    std::unique_ptr<shadow_page_table> table_;
+    shadow_page_table* table_;  // owned by the context shadow cache
+    uint64_t table_directory_;
     std::unique_ptr<page> shadow_ramin_;
 
     page_table_reuse_t original_;
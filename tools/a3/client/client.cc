@@ -64,6 +64,19 @@ int main(int argc, char** argv) {
     } else if (rest.front() == "register" && rest.size() >= 2) {
         command.value = a3::command::UTILITY_REGISTER_READ;
         command.offset = strtol(rest[1].c_str(), NULL, 16);
+    } else if (rest.front() == "locks") {
+        // lock statistics are dumped to the A3 log
+        command.value = a3::command::UTILITY_LOCK_STATISTICS;
+    } else if (rest.front() == "pmem") {
+        // PRAMIN window statistics are dumped to the A3 log
+        command.value = a3::command::UTILITY_PMEM_STATISTICS;
+    } else if (rest.front() == "p2m-invalidate") {
+        // drop gfn => mfn caches of all domains
+        command.value = a3::command::UTILITY_P2M_INVALIDATE;
+    } else if (rest.front() == "trace" && rest.size() >= 3) {
+        // trace categories(hex) level
+        command.value = a3::command::UTILITY_TRACE;
+        command.offset = (strtol(rest[2].c_str(), NULL, 10) << 16) | (strtol(rest[1].c_str(), NULL, 16) & 0xffff);
     } else {
         return 1;
     }
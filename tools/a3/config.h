@@ -19,7 +19,17 @@
 
 #define A3_BAR1_TOTAL_SIZE (128ULL * (1ULL << 20))
 #define A3_BAR1_POLL_AREA_SIZE (A3_CHANNELS * 0x1000ULL)  /* POLL AREA is reserved, 512KB */
-#define A3_BAR1_ARENA_SIZE ((A3_BAR1_TOTAL_SIZE - A3_BAR1_POLL_AREA_SIZE) / A3_VM_NUM)
+
+// BAR1 window mapped onto the head of the hypervisor VRAM pool,
+// so that A3 writes its own structures with CPU stores instead of PRAMIN
+#define A3_BAR1_APERTURE_OFFSET (64ULL * (1ULL << 20))
+#define A3_BAR1_APERTURE_SIZE (64ULL * (1ULL << 20))
+
+// Per VM BAR1 arenas between the poll area and the aperture. With
+// --bar1-remapping, the head of the guest BAR1 space is mirrored into the
+// arena of the VM and the guest BAR1 pages are mapped onto it directly
+#define A3_BAR1_ARENA_OFFSET A3_BAR1_POLL_AREA_SIZE
+#define A3_BAR1_ARENA_SIZE ((A3_BAR1_APERTURE_OFFSET - A3_BAR1_ARENA_OFFSET) / A3_VM_NUM)
 
 #define NOUVEAU_PV_REG_BAR 4
 #define NOUVEAU_PV_SLOT_SIZE 0x1000ULL
@@ -21,6 +21,7 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
  */
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
 #include <boost/asio.hpp>
@@ -40,6 +41,7 @@
 #include "page_table.h"
 #include "pv_page.h"
 #include "utility.h"
+#include "trace.h"
 #include "ignore_unused_variable_warning.h"
 namespace a3 {
 
@@ -54,7 +56,15 @@ context::context(session* s, bool through)
     , barrier_()
     , poll_area_()
     , reg32_()
+    , register_page_()
     , ramin_channel_map_()
+    , guest_page_table_map_()
+    , barrier_changes_()
+    , shadow_cache_()
+    , p2m_()
+    , bar1_tlb_()
+    , bar3_tlb_()
+    , bar1_address_()
     , bar3_address_()
     , pfifo_()
     , instruments_(new instruments_t(this))
@@ -79,6 +89,9 @@ context::context(session* s, bool through)
 
 context::~context() {
     if (initialized_) {
+        for (std::unique_ptr<channel>& chan : channels_) {
+            chan->release_table(this);
+        }
         device()->release_virt(id_, this);
         A3_LOG("END and release GPU id %u\n", id_);
     }
@@ -94,28 +107,77 @@ void context::initialize(int dom, bool para) {
     bar1_channel_.reset(new bar1_channel_t(this));
     bar3_channel_.reset(new bar3_channel_t(this));
     barrier_.reset(new barrier::table(get_address_shift(), vram_size()));
-    reg32_.reset(new uint32_t[A3_BAR0_SIZE / sizeof(uint32_t)]);
+    shadow_cache_.reset(new shadow_page_table_cache_t(this, flags::shadow_cache_budget));
+    p2m_.reset(new p2m_cache_t(domid()));
+    // frames of destroyed domains may be handed to this one
+    p2m_cache_t::bump();
+    register_page_.reset(new shared_region_t<register_page_t>(true, shared_name(session_->replaying() ? "a3_replay_registers_%u" : "a3_shared_registers_%u", id())));
+    register_page()->enabled.store(!through(), std::memory_order_release);
     for (std::size_t i = 0, iz = channels_.size(); i < iz; ++i) {
         channels_[i].reset(new channel(i));
     }
     initialized_ = true;
     A3_LOG("INIT domid %d & GPU id %u with %s\n", domid(), id(), para_virtualized() ? "Para-virt" : "Full-virt");
     buffer()->value = id();
+    buffer()->offset = flags::transport;
     session_->initialize(id());
 }
 
 // main entry
 bool context::handle(const command& cmd) {
+    const uint64_t start = trace::enabled(trace::CATEGORY_COMMAND, trace::LEVEL_INFO) ? trace::now() : 0;
+    const bool wait = dispatch(cmd);
+    remap_barrier_changes();
+    trace::record_command(id(), cmd, buffer()->value, start);
+    return wait;
+}
+
+// Guest page tables are tracked as barriers while they are shadowed. Arena
+// pages aliasing them are made read-only / unmapped (or mapped again) here,
+// once no lock is held.
+void context::remap_barrier_changes() {
+    if (barrier_changes_.empty()) {
+        return;
+    }
+    std::sort(barrier_changes_.begin(), barrier_changes_.end());
+    barrier_changes_.erase(std::unique(barrier_changes_.begin(), barrier_changes_.end()), barrier_changes_.end());
+    A3_SYNCHRONIZED(device()->bar1()->mutex()) {
+        device()->bar1()->remap_barriers(this, barrier_changes_);
+    }
+    A3_SYNCHRONIZED(device()->bar3()->mutex()) {
+        device()->bar3()->remap_barriers(this, barrier_changes_);
+    }
+    barrier_changes_.clear();
+}
+
+bool context::dispatch(const command& cmd) {
     if (cmd.type == command::TYPE_INIT) {
         initialize(cmd.value, cmd.offset != 0);
         return false;
     }
 
+    if (cmd.type == command::TYPE_BAR1) {
+        const uint64_t address = (static_cast<uint64_t>(cmd.value) << 32) | cmd.offset;
+        A3_LOG("BAR1 address notification %" PRIx64 "\n", address);
+        A3_SYNCHRONIZED(device()->bar1()->mutex()) {
+            // drop the remapped pages of the old BAR1 location
+            device()->bar1()->unmap_xen_pages(this);
+            bar1_address_ = address;
+            device()->bar1()->remap(this);
+        }
+        return false;
+    }
+
     if (cmd.type == command::TYPE_BAR3) {
         uint64_t tmp = static_cast<uint64_t>(cmd.value) << 12;
         tmp += cmd.offset;
-        bar3_address_ = tmp;
-        A3_LOG("BAR3 address notification %" PRIx64 "\n", bar3_address());
+        A3_LOG("BAR3 address notification %" PRIx64 "\n", tmp);
+        A3_SYNCHRONIZED(device()->bar3()->mutex()) {
+            // drop the remapped pages of the old BAR3 location
+            device()->bar3()->unmap_xen_pages(this);
+            bar3_address_ = tmp;
+            device()->bar3()->remap(this);
+        }
         return false;
     }
 
@@ -152,13 +214,64 @@ bool context::handle(const command& cmd) {
                 A3_LOG("clear context shadowing utilizations\n");
             }
             break;
+
+        case command::UTILITY_TRACE: {
+                // offset: level << 16 | categories. value: 0 without --trace
+                if (!trace::configure(bit_mask<16>(cmd.offset), static_cast<trace::level_t>(cmd.offset >> 16))) {
+                    A3_LOG("trace is not available without --trace\n");
+                    buffer()->value = 0;
+                    break;
+                }
+                A3_LOG("trace categories 0x%" PRIx32 " level %" PRIu32 "\n", bit_mask<16>(cmd.offset), cmd.offset >> 16);
+                buffer()->value = 1;
+            }
+            break;
+
+        case command::UTILITY_LOCK_STATISTICS: {
+                // dump and clear. value: total contended count
+                if (!flags::lock_statistics) {
+                    A3_LOG("lock acquisitions and hold times need --lock-statistics\n");
+                }
+                uint64_t contended = 0;
+                for (int i = 0; i < LOCK_RANKS; ++i) {
+                    const lock_rank_t rank = static_cast<lock_rank_t>(i);
+                    lock_statistics_t* statistics = lock_statistics(rank);
+                    const uint64_t acquired = statistics->acquired.exchange(0);
+                    const uint64_t held = statistics->held.exchange(0);
+                    const uint64_t max_held = statistics->max_held.exchange(0);
+                    const uint64_t count = statistics->contended.exchange(0);
+                    A3_LOG("lock %-9s acquired %" PRIu64 " contended %" PRIu64 " held %" PRIu64 " ns max %" PRIu64 " ns\n",
+                           lock_rank_name(rank), acquired, count, held, max_held);
+                    contended += count;
+                }
+                buffer()->value = contended;
+            }
+            break;
+
+        case command::UTILITY_PMEM_STATISTICS: {
+                // dump and clear. value: window switch count
+                pmem::statistics_t* statistics = pmem::statistics();
+                const uint64_t accesses = statistics->accesses.exchange(0);
+                const uint64_t switches = statistics->switches.exchange(0);
+                const uint64_t batched = statistics->batched.exchange(0);
+                A3_LOG("pmem accesses %" PRIu64 " window switches %" PRIu64 " batched %" PRIu64 "\n", accesses, switches, batched);
+                buffer()->value = switches;
+            }
+            break;
+
+        case command::UTILITY_P2M_INVALIDATE:
+            // after the p2m of a domain is changed (ballooning etc.)
+            p2m_cache_t::bump();
+            A3_LOG("p2m caches invalidated\n");
+            break;
         }
         return false;
     }
 
     if (through()) {
-        A3_SYNCHRONIZED(device()->mutex()) {
-            // through mode. direct access
+        // through mode. direct access
+        // guest may move the PRAMIN window, so it is serialized with A3 accesses
+        A3_SYNCHRONIZED(device()->pmem_mutex()) {
             const uint32_t bar = cmd.bar();
             if (cmd.type == command::TYPE_WRITE) {
                 device()->write(bar, cmd.offset, cmd.value, cmd.size());
@@ -168,7 +281,6 @@ bool context::handle(const command& cmd) {
                 return true;
             }
         }
-        // inspect(cmd, buffer()->value);
         return false;
     }
 
@@ -177,15 +289,15 @@ bool context::handle(const command& cmd) {
         switch (cmd.bar()) {
         case command::BAR0:
             write_bar0(cmd);
-            A3_LOG("BAR0 write 0x%" PRIx32 " 0x%" PRIx32 "\n", cmd.offset, cmd.value);
+            if (const uint32_t* value = reg32_.find(cmd.offset)) {
+                register_page()->publish(cmd.offset, *value);
+            }
             break;
         case command::BAR1:
             write_bar1(cmd);
-            A3_LOG("BAR1 write 0x%" PRIx32 " 0x%" PRIx32 "\n", cmd.offset, cmd.value);
             break;
         case command::BAR3:
             write_bar3(cmd);
-            A3_LOG("BAR3 write 0x%" PRIx32 " 0x%" PRIx32 "\n", cmd.offset, cmd.value);
             break;
         case command::BAR4:
             write_bar4(cmd);
@@ -199,23 +311,18 @@ bool context::handle(const command& cmd) {
         switch (cmd.bar()) {
         case command::BAR0:
             read_bar0(cmd);
-            A3_LOG("BAR0 read  0x%" PRIx32 " 0x%" PRIx32 "\n", cmd.offset, buffer()->value);
             break;
         case command::BAR1:
             read_bar1(cmd);
-            A3_LOG("BAR1 read  0x%" PRIx32 " 0x%" PRIx32 "\n", cmd.offset, buffer()->value);
             break;
         case command::BAR3:
             read_bar3(cmd);
-            A3_LOG("BAR3 read  0x%" PRIx32 " 0x%" PRIx32 "\n", cmd.offset, buffer()->value);
             break;
         case command::BAR4:
             read_bar4(cmd);
             break;
         }
     }
-    inspect(cmd, buffer()->value);
-
     return wait;
 }
 
@@ -259,12 +366,14 @@ void context::flush_tlb(uint32_t vspace, uint32_t trigger) {
 
     // A3_FATAL(stdout, "flush times %" PRIu64 "\n", increment_flush_times());
     A3_LOG("TLB flush 0x%" PRIX64 " pd\n", page_directory);
+    p2m()->synchronize();
 
     // rescan page tables
     if (bar1_channel()->table()->page_directory_address() == page_directory) {
         // BAR1
         bar1_channel()->table()->refresh_page_directories(this, page_directory);
-        A3_SYNCHRONIZED(device()->mutex()) {
+        bar1_tlb()->invalidate();
+        A3_SYNCHRONIZED(device()->bar1()->mutex()) {
             device()->bar1()->shadow(this);
             device()->bar1()->flush();
         }
@@ -273,7 +382,7 @@ void context::flush_tlb(uint32_t vspace, uint32_t trigger) {
     if (bar3_channel()->page_directory_address() == page_directory) {
         // BAR3
         bar3_channel()->refresh_table(this, page_directory);
-        A3_SYNCHRONIZED(device()->mutex()) {
+        A3_SYNCHRONIZED(device()->bar3()->mutex()) {
             device()->bar3()->shadow(this, page_directory);
             device()->bar3()->flush();
         }
@@ -282,8 +391,8 @@ void context::flush_tlb(uint32_t vspace, uint32_t trigger) {
     for (std::size_t i = 0, iz = channels_.size(); i < iz; ++i) {
         channel* channel = channels(i);
         if (channel->enabled()) {
-            A3_LOG("channel id %" PRIu64 " => 0x%" PRIx64 "\n", i, channel->table()->page_directory_address());
-            if (channel->table()->page_directory_address() == page_directory) {
+            A3_LOG("channel id %" PRIu64 " => 0x%" PRIx64 "\n", i, channel->table() ? channel->table()->page_directory_address() : 0);
+            if (channel->table() && channel->table()->page_directory_address() == page_directory) {
                 channel->tlb_flush_needed();
                 if (already) {
                     channel->override_shadow(this, already, reuse);
@@ -332,10 +441,7 @@ struct page_entry context::guest_to_host(const struct page_entry& entry) {
         } else if (entry.target == page_entry::TARGET_TYPE_SYSRAM || entry.target == page_entry::TARGET_TYPE_SYSRAM_NO_SNOOP) {
             // rewrite address
             const uint32_t gfn = (uint32_t)(result.address);
-            uint32_t mfn = 0;
-            A3_SYNCHRONIZED(device()->mutex()) {
-                mfn = a3_xen_gfn_to_mfn(device()->xl_ctx(), domid(), gfn);
-            }
+            const uint32_t mfn = p2m()->lookup(gfn);
             // const uint64_t h_address = ctx->get_phys_address(g_address);
             result.address = (uint32_t)(mfn);
             // TODO(Yusuke Suzuki): Validate host physical address in Xen side
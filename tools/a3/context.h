@@ -3,6 +3,7 @@
 #include <array>
 #include <memory>
 #include <queue>
+#include <vector>
 #include <boost/unordered_map.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/ptr_container/ptr_unordered_map.hpp>
@@ -18,6 +19,13 @@
 #include "duration.h"
 #include "pfifo.h"
 #include "poll_area.h"
+#include "register_file.h"
+#include "register_page.h"
+#include "register_map.h"
+#include "shared_region.h"
+#include "shadow_page_table_cache.h"
+#include "p2m_cache.h"
+#include "software_tlb.h"
 namespace a3 {
 namespace barrier {
 class table;
@@ -26,9 +34,15 @@ class table;
 struct slot_t;
 class pv_page;
 
+struct bar0_dispatch;
+
 class context : private boost::noncopyable, public boost::intrusive::list_base_hook<> {
  public:
+    friend struct bar0_dispatch;
+    typedef void (context::*bar0_handler_t)(const command& cmd);
+
     typedef boost::unordered_multimap<uint64_t, channel*> channel_map;
+    typedef boost::unordered_multimap<uint64_t, shadow_page_table*> page_table_map;
 
     context(session* session, bool through);
     virtual ~context();
@@ -42,6 +56,7 @@ class context : private boost::noncopyable, public boost::intrusive::list_base_h
     void read_bar3(const command& command);
     void read_bar4(const command& command);
     void read_barrier(uint64_t addr, const command& command);
+    void write_span(const command* entries, uint32_t count);
     void write_barrier(uint64_t addr, const command& command);
     bool through() const { return through_; }
     bar1_channel_t* bar1_channel() { return bar1_channel_.get(); }
@@ -54,6 +69,15 @@ class context : private boost::noncopyable, public boost::intrusive::list_base_h
     const barrier::table* barrier() const { return barrier_.get(); }
     channel_map* ramin_channel_map() { return &ramin_channel_map_; }
     const channel_map* ramin_channel_map() const { return &ramin_channel_map_; }
+    // guest page directory / table pages => tracking shadow page tables
+    page_table_map* guest_page_table_map() { return &guest_page_table_map_; }
+    shadow_page_table_cache_t* shadow_cache() { return shadow_cache_.get(); }
+    p2m_cache_t* p2m() { return p2m_.get(); }
+    software_tlb_t* bar1_tlb() { return &bar1_tlb_; }
+    software_tlb_t* bar3_tlb() { return &bar3_tlb_; }
+    const page_table_map* guest_page_table_map() const { return &guest_page_table_map_; }
+    // page became / stopped being a barrier outside of channel RAMIN updates
+    void barrier_changed(uint64_t page) { barrier_changes_.push_back(page); }
     uint64_t vram_size() const { return A3_MEMORY_SIZE; }
     uint64_t get_address_shift() const {
         return id() * vram_size();
@@ -74,6 +98,7 @@ class context : private boost::noncopyable, public boost::intrusive::list_base_h
     int domid() const { return domid_; }
     bool flush(uint64_t pd, bool bar = false);
     command* buffer() { return session_->buffer(); }
+    uint64_t bar1_address() const { return bar1_address_; }
     uint64_t bar3_address() const { return bar3_address_; }
     bool in_memory_range(uint64_t phys) const {
         return get_virt_address(phys) < vram_size();
@@ -105,16 +130,22 @@ class context : private boost::noncopyable, public boost::intrusive::list_base_h
     void update_budget(const duration_t& credit);
 
     uint32_t& reg32(uint64_t offset) {
-        return reg32_[offset / sizeof(uint32_t)];
+        return reg32_[offset];
     }
     pfifo_t* pfifo() { return &pfifo_; }
     const pfifo_t* pfifo() const { return &pfifo_; }
     const poll_area_t* poll_area() const { return &poll_area_; }
+    register_page_t* register_page() const { return register_page_->get(); }
 
  private:
     void initialize(int domid, bool para);
+    bool dispatch(const command& command);
+    void remap_barrier_changes();
     void playlist_update(uint32_t reg_addr, uint32_t cmd);
     void flush_tlb(uint32_t vspace, uint32_t trigger);
+    // BAR virtual address => guest physical address through the software TLB
+    uint64_t translate_bar1(uint32_t offset, bool* is_barrier);
+    uint64_t translate_bar3(uint32_t offset, bool* is_barrier);
     uint32_t decode_to_virt_ramin(uint32_t value);
     uint32_t encode_to_shadow_ramin(uint32_t value);
     bool shadow_ramin_to_phys(uint64_t shadow, uint64_t* phys);
@@ -131,6 +162,11 @@ class context : private boost::noncopyable, public boost::intrusive::list_base_h
     }
     int pv_map(pv_page* pgt, uint32_t index, uint64_t guest, uint64_t host);
 
+    // BAR0 register handlers
+#define V(name) void name(const command& cmd);
+    A3_BAR0_HANDLERS(V)
+#undef V
+
     session* session_;
     bool through_;
     bool initialized_;
@@ -141,8 +177,16 @@ class context : private boost::noncopyable, public boost::intrusive::list_base_h
     std::array<std::unique_ptr<channel>, A3_DOMAIN_CHANNELS> channels_;
     std::unique_ptr<barrier::table> barrier_;
     poll_area_t poll_area_;
-    std::unique_ptr<uint32_t[]> reg32_;
+    register_file_t reg32_;
+    std::unique_ptr<shared_region_t<register_page_t>> register_page_;
     channel_map ramin_channel_map_;
+    page_table_map guest_page_table_map_;
+    std::vector<uint64_t> barrier_changes_;
+    std::unique_ptr<shadow_page_table_cache_t> shadow_cache_;
+    std::unique_ptr<p2m_cache_t> p2m_;
+    software_tlb_t bar1_tlb_;
+    software_tlb_t bar3_tlb_;
+    uint64_t bar1_address_;
     uint64_t bar3_address_;
     pfifo_t pfifo_;
 
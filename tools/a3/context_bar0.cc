@@ -35,428 +35,332 @@
 #include "device_bar1.h"
 #include "device_bar3.h"
 #include "shadow_page_table.h"
+#include "register_map.h"
 #include "ignore_unused_variable_warning.h"
 namespace a3 {
 
-void context::write_bar0(const command& cmd) {
-    switch (cmd.offset) {
-    case 0x001700: {
-            // pmem
-            reg32(cmd.offset) = cmd.value;
-            return;
-        }
-    case 0x001704: {
-            // BAR1 channel
-            reg32(cmd.offset) = cmd.value;
-            const uint64_t virt = (bit_mask<28, uint64_t>(cmd.value) << 12);
-            const uint64_t phys = get_phys_address(virt);
-            const uint32_t value = bit_clear<28>(cmd.value) | (phys >> 12);
-            ignore_unused_variable_warning(value);
-            A3_LOG("0x1704 => 0x%" PRIX32 "\n", value);
-            bar1_channel()->refresh(this, phys);
-            A3_SYNCHRONIZED(device()->mutex()) {
-                device()->bar1()->refresh();
-            }
-            return;
-        }
-    case 0x001714: {
-            // BAR3 channel
-            reg32(cmd.offset) = cmd.value;
-            const uint64_t virt = (bit_mask<28, uint64_t>(cmd.value) << 12);
-            const uint64_t phys = get_phys_address(virt);
-            const uint32_t value = bit_clear<28>(cmd.value) | (phys >> 12);
-            ignore_unused_variable_warning(value);
-            A3_LOG("0x1714 => 0x%" PRIX32 "\n", value);
-            bar3_channel()->refresh(this, phys);
-            A3_SYNCHRONIZED(device()->mutex()) {
-                device()->bar3()->refresh();
+struct bar0_dispatch {
+    typedef register_entry_t<context::bar0_handler_t> entry_t;
+    typedef register_range_t<context::bar0_handler_t> range_t;
+
+#define V(offset, name) { offset, &context::name },
+    static constexpr entry_t kWRITE_REGISTERS[] = {
+        A3_BAR0_WRITE_REGISTERS(V)
+    };
+    static constexpr entry_t kREAD_REGISTERS[] = {
+        A3_BAR0_READ_REGISTERS(V)
+    };
+#undef V
+
+#define V(begin, end, write, read) { begin, end, &context::write, &context::read },
+    static constexpr range_t kNVC0_RANGES[] = {
+        A3_BAR0_NVC0_RANGES(V)
+    };
+    static constexpr range_t kNVE0_RANGES[] = {
+        A3_BAR0_NVE0_RANGES(V)
+    };
+#undef V
+
+    static const range_t* lookup_range(uint32_t offset) {
+        const bool nvc0 = device()->chipset()->type() == card::NVC0;
+        const range_t* ranges = nvc0 ? kNVC0_RANGES : kNVE0_RANGES;
+        const std::size_t size = nvc0 ?
+            sizeof(kNVC0_RANGES) / sizeof(range_t) :
+            sizeof(kNVE0_RANGES) / sizeof(range_t);
+        for (std::size_t i = 0; i < size; ++i) {
+            if (ranges[i].begin <= offset && offset < ranges[i].end) {
+                return &ranges[i];
             }
-            return;
-        }
-    case 0x002254: {
-            // POLL_AREA
-            poll_area_.set_area(bit_mask<28, uint64_t>(cmd.value) << 12);
-            reg32(cmd.offset) = cmd.value;
-            A3_SYNCHRONIZED(device()->mutex()) {
-                device()->bar1()->refresh_poll_area();
-            }
-            return;
-        }
-    case 0x002270: {
-            // PLAYLIST_WR
-            reg32(cmd.offset) = cmd.value;
-            return;
-        }
-    case 0x002274: {
-            // PLAYLIST_WR_LEN
-            reg32(cmd.offset) = cmd.value;
-            // Update playlist.
-            playlist_update(reg32(0x2270), reg32(0x2274));
-            return;
-        }
-    case 0x00227c: {
-            // PLAYLIST_RD_LEN
-            break;
-        }
-    case 0x002634: {
-            // channel kill
-            if (cmd.value >= A3_DOMAIN_CHANNELS) {
-                return;
-            }
-            const uint32_t phys = get_phys_channel_id(cmd.value);
-            A3_LOG("killing cid %" PRIx32 "\n", phys);
-            registers::accessor regs;
-            regs.write32(cmd.offset, phys);
-            if (!regs.wait_eq(0x002634, 0xffffffff, phys)) {
-                A3_LOG("failed killing cid %" PRIx32 "\n", phys);
-            }
-            reg32(cmd.offset) = cmd.value;
-            return;
         }
+        return nullptr;
+    }
+};
 
-    case 0x070000: {
-            // PFIFO flush state / trigger
-            registers::accessor regs;
-            regs.write32(cmd.offset, cmd.value);
-            A3_LOG("PRAMIN FLUSH STATE WRITE %" PRIx32 "\n", cmd.value);
-        }
-        return;
+constexpr bar0_dispatch::entry_t bar0_dispatch::kWRITE_REGISTERS[];
+constexpr bar0_dispatch::entry_t bar0_dispatch::kREAD_REGISTERS[];
+constexpr bar0_dispatch::range_t bar0_dispatch::kNVC0_RANGES[];
+constexpr bar0_dispatch::range_t bar0_dispatch::kNVE0_RANGES[];
 
-    case 0x022438:
-        // memctrl size (2)
-        return;
+static_assert(is_sorted_register_map(bar0_dispatch::kWRITE_REGISTERS), "BAR0 write registers should be sorted");
+static_assert(is_sorted_register_map(bar0_dispatch::kREAD_REGISTERS), "BAR0 read registers should be sorted");
 
-    case 0x100cb8:
-        // cmd vspace
-        reg32(cmd.offset) = cmd.value;
+void context::write_bar0(const command& cmd) {
+    if (const bar0_handler_t handler = lookup_register_map(bar0_dispatch::kWRITE_REGISTERS, cmd.offset)) {
+        (this->*handler)(cmd);
         return;
+    }
 
-    case 0x100cbc:
-        // cmd trigger
-        // In this case, TLB flush cmd
-        reg32(cmd.offset) = cmd.value;
-        flush_tlb(reg32(0x100cb8), reg32(0x100cbc));
+    if (const bar0_dispatch::range_t* range = bar0_dispatch::lookup_range(cmd.offset)) {
+        (this->*(range->write))(cmd);
         return;
+    }
 
-    case 0x100c80: {
-            // TLB flush
-            // flush_tlb(reg32(0x100cb8), reg32(0x100cbc));
-            // return;
-            break;
-        }
-
-    case 0x104050:
-    case 0x104054:
-    case 0x105050:
-    case 0x105054: {
-            // PCOPY 0x104000 + 0x050
-            //                + 0x054
-            // PCOPY 0x105000 + 0x050
-            //                + 0x050
-            // TODO(Yusuke Suzuki) needs to limit engine
-            const uint32_t value = encode_to_shadow_ramin(cmd.value);
-            registers::write32(cmd.offset, value);
-            return;
-        }
+    registers::accessor regs;
+    regs.write(cmd.offset, cmd.value, cmd.size());
+}
 
-    case 0x121c75:
-        // memctrl size (2)
+void context::read_bar0(const command& cmd) {
+    if (const bar0_handler_t handler = lookup_register_map(bar0_dispatch::kREAD_REGISTERS, cmd.offset)) {
+        (this->*handler)(cmd);
         return;
+    }
 
-    // icmd
-    case 0x400204:
-        reg32(cmd.offset) = cmd.value;
+    if (const bar0_dispatch::range_t* range = bar0_dispatch::lookup_range(cmd.offset)) {
+        (this->*(range->read))(cmd);
         return;
+    }
 
-    case 0x400200: {
-            registers::accessor regs;
-            regs.write32(0x400204, reg32(0x400204));
-            regs.write32(0x400200, cmd.value);
-            A3_LOG("icmd %" PRIX32 "|%" PRIX32 "\n", reg32(0x400204), cmd.value);
-            return;
-        }
+    registers::accessor regs;
+    buffer()->value = regs.read(cmd.offset, cmd.size());
+}
 
-    // mthd
-    case 0x40448c:
-        reg32(cmd.offset) = cmd.value;
-        return;
+void context::bar0_write_virtual(const command& cmd) {
+    reg32(cmd.offset) = cmd.value;
+}
 
-    case 0x404488: {
-            registers::accessor regs;
-            regs.write32(0x40448c, reg32(0x40448c));
-            regs.write32(0x404488, cmd.value);
-            A3_LOG("method %" PRIX32 "|%" PRIX32 "\n", reg32(0x40448c), cmd.value);
-            return;
-        }
+void context::bar0_write_bar1_channel(const command& cmd) {
+    // BAR1 channel
+    reg32(cmd.offset) = cmd.value;
+    const uint64_t virt = (bit_mask<28, uint64_t>(cmd.value) << 12);
+    const uint64_t phys = get_phys_address(virt);
+    const uint32_t value = bit_clear<28>(cmd.value) | (phys >> 12);
+    ignore_unused_variable_warning(value);
+    A3_LOG("0x1704 => 0x%" PRIX32 "\n", value);
+    bar1_channel()->refresh(this, phys);
+    A3_SYNCHRONIZED(device()->bar1()->mutex()) {
+        device()->bar1()->refresh();
+    }
+}
 
-    case 0x409500:
-        // WRCMD_DATA
-        reg32(cmd.offset) = cmd.value;
-        return;
+void context::bar0_write_bar3_channel(const command& cmd) {
+    // BAR3 channel
+    reg32(cmd.offset) = cmd.value;
+    const uint64_t virt = (bit_mask<28, uint64_t>(cmd.value) << 12);
+    const uint64_t phys = get_phys_address(virt);
+    const uint32_t value = bit_clear<28>(cmd.value) | (phys >> 12);
+    ignore_unused_variable_warning(value);
+    A3_LOG("0x1714 => 0x%" PRIX32 "\n", value);
+    bar3_channel()->refresh(this, phys);
+    A3_SYNCHRONIZED(device()->bar3()->mutex()) {
+        device()->bar3()->refresh();
+    }
+}
 
-    case 0x409504: {
-            // WRCMD_CMD
-            reg32(cmd.offset) = cmd.value;
-            uint32_t data = reg32(0x409500);
-            if (bit_check<31>(data)) {
-                // VRAM address
-                const uint64_t virt = (bit_mask<28, uint64_t>(data) << 12);
-                const uint64_t phys = get_phys_address(virt);
-
-                data = bit_clear<28>(data) | (phys >> 12);
-
-                typedef context::channel_map::iterator iter_t;
-                const std::pair<iter_t, iter_t> range = ramin_channel_map()->equal_range(phys);
-
-                if (range.first == range.second) {
-                    // no channel found
-                    data = bit_clear<28>(data) | (phys >> 12);
-                    A3_LOG("channel not found graph\n");
-                } else {
-                    // channel found
-                    // channel ramin shift
-                    // FIXME(Yusuke Suzuki): do FIRE like code
-                    A3_LOG("WRCMD start cmd %" PRIX32 "\n", cmd.value);
-                    A3_SYNCHRONIZED(device()->mutex()) {
-                        for (iter_t it = range.first; it != range.second; ++it) {
-                            const uint32_t res = bit_clear<28>(data) | (it->second->shadow_ramin()->address() >> 12);
-                            if (a3::flags::lazy_shadowing) {
-                                it->second->flush(this);
-                            }
-                            A3_LOG("    channel %d ramin graph with cmd %" PRIX32 " with addr %" PRIX64 " : %" PRIX32 " => %" PRIX32 "\n", it->second->id(), cmd.value, it->second->shadow_ramin()->address(), data, res);
-
-                            // Because we doesn't recognize PCOPY engine initialization
-                            // it->second->shadow(this);
-
-                            registers::write32(0x409500, res);
-                            registers::write32(0x409504, cmd.value);
-                        }
-                    }
-                    A3_LOG("WRCMD end cmd %" PRIX32 "\n", cmd.value);
-                    return;
-                }
-            }
+void context::bar0_write_poll_area(const command& cmd) {
+    // POLL_AREA
+    poll_area_.set_area(bit_mask<28, uint64_t>(cmd.value) << 12);
+    reg32(cmd.offset) = cmd.value;
+    A3_SYNCHRONIZED(device()->bar1()->mutex()) {
+        device()->bar1()->refresh_poll_area();
+    }
+}
 
-            // fire cmd
-            // TODO(Yusuke Suzuki): queued system needed
-            A3_SYNCHRONIZED(device()->mutex()) {
-                registers::write32(0x409500, data);
-                registers::write32(0x409504, cmd.value);
-            }
-            return;
-        }
+void context::bar0_write_playlist(const command& cmd) {
+    // PLAYLIST_WR_LEN
+    reg32(cmd.offset) = cmd.value;
+    // Update playlist.
+    playlist_update(reg32(0x2270), reg32(0x2274));
+}
 
-    case 0x409b00:
-        // graph IRQ channel instance
+void context::bar0_write_channel_kill(const command& cmd) {
+    // channel kill
+    if (cmd.value >= A3_DOMAIN_CHANNELS) {
         return;
-
-    case 0x4188b4: {
-            // GPC_BCAST(0x08b4)
-            reg32(cmd.offset) = cmd.value;
-            const uint64_t virt = (static_cast<uint64_t>(cmd.value) << 8);
-            const uint64_t phys = get_phys_address(virt);
-            const uint32_t value = phys >> 8;
-            registers::write32(cmd.offset, value);
-            return;
-        }
-
-    case 0x4188b8: {
-            // GPC_BCAST(0x08b8)
-            reg32(cmd.offset) = cmd.value;
-            const uint64_t virt = (static_cast<uint64_t>(cmd.value) << 8);
-            const uint64_t phys = get_phys_address(virt);
-            const uint32_t value = phys >> 8;
-            registers::write32(cmd.offset, value);
-            return;
-        }
-
-    case 0x610010: {
-            // NV50 PDISPLAY OBJECTS
-            reg32(cmd.offset) = cmd.value;
-            const uint32_t value = cmd.value + (get_address_shift() >> 8);
-            registers::write32(cmd.offset, value);
-            return;
-        }
     }
-
-    // pmem / PMEM
-    if (0x700000 <= cmd.offset && cmd.offset < 0x800000) {
-        const uint64_t base = get_phys_address(static_cast<uint64_t>(reg32(0x1700)) << 16);
-        const uint64_t addr = base + (cmd.offset - 0x700000);
-        pmem::accessor pmem;
-        pmem.write(addr, cmd.value, cmd.size());
-        barrier::page_entry* entry = nullptr;
-        // A3_LOG("write to PMEM 0x%" PRIX64 " 0x%" PRIX32 " 0x%" PRIX64 " 0x%" PRIx32 "\n", base, cmd.offset - 0x700000, addr, cmd.value);
-        if (barrier()->lookup(addr, &entry, false)) {
-            // found
-            write_barrier(addr, cmd);
-        }
-        return;
+    const uint32_t phys = get_phys_channel_id(cmd.value);
+    A3_LOG("killing cid %" PRIx32 "\n", phys);
+    registers::accessor regs;
+    regs.write32(cmd.offset, phys);
+    if (!regs.wait_eq(0x002634, 0xffffffff, phys)) {
+        A3_LOG("failed killing cid %" PRIx32 "\n", phys);
     }
+    reg32(cmd.offset) = cmd.value;
+}
 
-    // PFIFO
-    // Since NVE0 has different range, we need to create 2 pathes.
-    if (pfifo_.in_range(cmd.offset)) {
-        pfifo_.write(this, cmd);
-        return;
-    }
+void context::bar0_write_ignored(const command& cmd) {
+    // memctrl size (2), graph IRQ channel instance
+}
 
+void context::bar0_write_pfifo_flush(const command& cmd) {
+    // PFIFO flush state / trigger
     registers::accessor regs;
-    regs.write(cmd.offset, cmd.value, cmd.size());
+    regs.write32(cmd.offset, cmd.value);
+    A3_LOG("PRAMIN FLUSH STATE WRITE %" PRIx32 "\n", cmd.value);
 }
 
-void context::read_bar0(const command& cmd) {
-    switch (cmd.offset) {
-    case 0x001700:
-        buffer()->value = reg32(cmd.offset);
-        return;
+void context::bar0_write_tlb_flush(const command& cmd) {
+    // cmd trigger
+    // In this case, TLB flush cmd
+    reg32(cmd.offset) = cmd.value;
+    flush_tlb(reg32(0x100cb8), reg32(0x100cbc));
+}
 
-    case 0x001704:
-        buffer()->value = reg32(cmd.offset);
-        return;
+void context::bar0_write_pcopy_instance(const command& cmd) {
+    // PCOPY 0x104000 + 0x050
+    //                + 0x054
+    // PCOPY 0x105000 + 0x050
+    //                + 0x050
+    // TODO(Yusuke Suzuki) needs to limit engine
+    const uint32_t value = encode_to_shadow_ramin(cmd.value);
+    registers::write32(cmd.offset, value);
+}
 
-    case 0x001714:
-        buffer()->value = reg32(cmd.offset);
-        return;
+void context::bar0_write_icmd(const command& cmd) {
+    registers::accessor regs;
+    regs.write32(0x400204, reg32(0x400204));
+    regs.write32(0x400200, cmd.value);
+    A3_LOG("icmd %" PRIX32 "|%" PRIX32 "\n", reg32(0x400204), cmd.value);
+}
 
-    case 0x002254:
-        buffer()->value = reg32(cmd.offset);
-        return;
+void context::bar0_write_method(const command& cmd) {
+    registers::accessor regs;
+    regs.write32(0x40448c, reg32(0x40448c));
+    regs.write32(0x404488, cmd.value);
+    A3_LOG("method %" PRIX32 "|%" PRIX32 "\n", reg32(0x40448c), cmd.value);
+}
 
-    case 0x002270:
-        buffer()->value = reg32(cmd.offset);
-        return;
+void context::bar0_write_wrcmd(const command& cmd) {
+    // WRCMD_CMD
+    reg32(cmd.offset) = cmd.value;
+    uint32_t data = reg32(0x409500);
+    if (bit_check<31>(data)) {
+        // VRAM address
+        const uint64_t virt = (bit_mask<28, uint64_t>(data) << 12);
+        const uint64_t phys = get_phys_address(virt);
+
+        data = bit_clear<28>(data) | (phys >> 12);
+
+        typedef context::channel_map::iterator iter_t;
+        const std::pair<iter_t, iter_t> range = ramin_channel_map()->equal_range(phys);
+
+        if (range.first == range.second) {
+            // no channel found
+            data = bit_clear<28>(data) | (phys >> 12);
+            A3_LOG("channel not found graph\n");
+        } else {
+            // channel found
+            // channel ramin shift
+            // FIXME(Yusuke Suzuki): do FIRE like code
+            A3_LOG("WRCMD start cmd %" PRIX32 "\n", cmd.value);
+            for (iter_t it = range.first; it != range.second; ++it) {
+                const uint32_t res = bit_clear<28>(data) | (it->second->shadow_ramin()->address() >> 12);
+                if (a3::flags::lazy_shadowing) {
+                    // channel state is per context, so flush is done
+                    // before taking the register lock
+                    it->second->flush(this);
+                }
+                A3_LOG("    channel %d ramin graph with cmd %" PRIX32 " with addr %" PRIX64 " : %" PRIX32 " => %" PRIX32 "\n", it->second->id(), cmd.value, it->second->shadow_ramin()->address(), data, res);
 
-    case 0x002274:
-        break;
+                // Because we doesn't recognize PCOPY engine initialization
+                // it->second->shadow(this);
 
-    case 0x002634: {
-            // channel kill
-            // registers::accessor regs;
-            // const uint32_t phys = regs.read32(cmd.offset);
-            // const uint32_t virt = get_virt_channel_id(phys);
-            buffer()->value = reg32(cmd.offset);
-            // A3_LOG("killed cid %" PRIx32 " / %" PRIx32 "\n", virt, phys);
+                // data and cmd should not be interleaved with other contexts
+                registers::accessor regs;
+                regs.write32(0x409500, res);
+                regs.write32(0x409504, cmd.value);
+            }
+            A3_LOG("WRCMD end cmd %" PRIX32 "\n", cmd.value);
             return;
         }
-        return;
-
-    case 0x070000: {
-            // PFIFO flush state / trigger
-            registers::accessor regs;
-            buffer()->value = regs.read32(cmd.offset);
-            A3_LOG("PRAMIN FLUSH STATE READ  %" PRIx32 "\n", buffer()->value);
-        }
-        return;
+    }
 
-    case 0x022438:
-        // memory controller size
-        buffer()->value = A3_MEMORY_CTL_NUM;
-        return;
+    // fire cmd
+    // TODO(Yusuke Suzuki): queued system needed
+    registers::accessor regs;
+    regs.write32(0x409500, data);
+    regs.write32(0x409504, cmd.value);
+}
 
-    case 0x100cb8:
-        // cmd vspace
-        buffer()->value = reg32(cmd.offset);
-        return;
+void context::bar0_write_gpc_bcast(const command& cmd) {
+    // GPC_BCAST(0x08b4) / GPC_BCAST(0x08b8)
+    reg32(cmd.offset) = cmd.value;
+    const uint64_t virt = (static_cast<uint64_t>(cmd.value) << 8);
+    const uint64_t phys = get_phys_address(virt);
+    const uint32_t value = phys >> 8;
+    registers::write32(cmd.offset, value);
+}
 
-    case 0x100cbc:
-        // cmd trigger
-        // In this case, TLB flush cmd
-        buffer()->value = reg32(cmd.offset);
-        return;
+void context::bar0_write_pdisplay_objects(const command& cmd) {
+    // NV50 PDISPLAY OBJECTS
+    reg32(cmd.offset) = cmd.value;
+    const uint32_t value = cmd.value + (get_address_shift() >> 8);
+    registers::write32(cmd.offset, value);
+}
 
-    case 0x104050:
-    case 0x104054:
-    case 0x105050:
-    case 0x105054: {
-            // PCOPY 0x104000 + 0x050
-            //                + 0x054
-            // PCOPY 0x105000 + 0x050
-            //                + 0x050
-            // TODO(Yusuke Suzuki) needs to limit engine
-            const uint32_t value = decode_to_virt_ramin(registers::read32(cmd.offset));
-            buffer()->value = value;
-            return;
-        }
+void context::bar0_write_pramin(const command& cmd) {
+    // pmem / PMEM
+    const uint64_t base = get_phys_address(static_cast<uint64_t>(reg32(0x1700)) << 16);
+    const uint64_t addr = base + (cmd.offset - 0x700000);
+    {
+        // released before write_barrier, which takes the BAR1 / BAR3 locks
+        pmem::accessor pmem;
+        pmem.write(addr, cmd.value, cmd.size());
+    }
+    // A3_LOG("write to PMEM 0x%" PRIX64 " 0x%" PRIX32 " 0x%" PRIX64 " 0x%" PRIx32 "\n", base, cmd.offset - 0x700000, addr, cmd.value);
+    if (barrier()->contains(addr)) {
+        // found
+        write_barrier(addr, cmd);
+    }
+}
 
-    case 0x121c74:
-        // memory controller size
-        buffer()->value = A3_MEMORY_CTL_NUM;
-        return;
+void context::bar0_write_pfifo(const command& cmd) {
+    // PFIFO
+    pfifo_.write(this, cmd);
+}
 
-    case 0x409500:
-        // WRCMD_DATA
-        buffer()->value = reg32(cmd.offset);
-        return;
+void context::bar0_read_virtual(const command& cmd) {
+    buffer()->value = reg32(cmd.offset);
+}
 
-    case 0x409504:
-        // WRCMD_CMD
-        buffer()->value = reg32(cmd.offset);
-        return;
+void context::bar0_read_memory_controllers(const command& cmd) {
+    // memory controller size
+    buffer()->value = A3_MEMORY_CTL_NUM;
+}
 
-    case 0x409b00: {
-            // graph IRQ channel instance
-            const uint32_t value = registers::read32(cmd.offset);
-            buffer()->value = value - (get_address_shift() >> 12);
-            return;
-        }
+void context::bar0_read_pfifo_flush(const command& cmd) {
+    // PFIFO flush state / trigger
+    registers::accessor regs;
+    buffer()->value = regs.read32(cmd.offset);
+    A3_LOG("PRAMIN FLUSH STATE READ  %" PRIx32 "\n", buffer()->value);
+}
 
-    case 0x4188b4:
-        // GPC_BCAST(0x08b4)
-        buffer()->value = reg32(cmd.offset);
-        return;
+void context::bar0_read_pcopy_instance(const command& cmd) {
+    // PCOPY 0x104000 + 0x050
+    //                + 0x054
+    // PCOPY 0x105000 + 0x050
+    //                + 0x050
+    // TODO(Yusuke Suzuki) needs to limit engine
+    const uint32_t value = decode_to_virt_ramin(registers::read32(cmd.offset));
+    buffer()->value = value;
+}
 
-    case 0x4188b8:
-        // GPC_BCAST(0x08b8)
-        buffer()->value = reg32(cmd.offset);
-        return;
+void context::bar0_read_memory_partition(const command& cmd) {
+    // psize & bsize (it should be equal to psize for uniform memory layout)
+    buffer()->value = A3_MEMORY_CTL_PART >> 20;
+}
 
-    case 0x610010:
-        // NV50 PDISPLAY OBJECTS
-        buffer()->value = reg32(cmd.offset);
-        return;
-    }
+void context::bar0_read_graph_irq_instance(const command& cmd) {
+    // graph IRQ channel instance
+    const uint32_t value = registers::read32(cmd.offset);
+    buffer()->value = value - (get_address_shift() >> 12);
+}
 
+void context::bar0_read_pramin(const command& cmd) {
     // pmem / PMEM
-    if (0x700000 <= cmd.offset && cmd.offset < 0x800000) {
-        const uint64_t base = get_phys_address(static_cast<uint64_t>(reg32(0x1700)) << 16);
-        const uint64_t addr = base + (cmd.offset - 0x700000);
-        pmem::accessor pmem;
-        buffer()->value = pmem.read(addr, cmd.size());
-        barrier::page_entry* entry = nullptr;
-        // A3_LOG("read from PMEM 0x%" PRIX64 " 0x%" PRIX32 " 0x%" PRIX64 "\n", base, cmd.offset - 0x700000, addr);
-        if (barrier()->lookup(addr, &entry, false)) {
-            // found
-            read_barrier(addr, cmd);
-        }
-        return;
+    const uint64_t base = get_phys_address(static_cast<uint64_t>(reg32(0x1700)) << 16);
+    const uint64_t addr = base + (cmd.offset - 0x700000);
+    pmem::accessor pmem;
+    buffer()->value = pmem.read(addr, cmd.size());
+    // A3_LOG("read from PMEM 0x%" PRIX64 " 0x%" PRIX32 " 0x%" PRIX64 "\n", base, cmd.offset - 0x700000, addr);
+    if (barrier()->contains(addr)) {
+        // found
+        read_barrier(addr, cmd);
     }
+}
 
+void context::bar0_read_pfifo(const command& cmd) {
     // PFIFO
-    // Since NVE0 has different range, we need to create 2 pathes.
-    if (pfifo_.in_range(cmd.offset)) {
-        buffer()->value = pfifo_.read(this, cmd);
-        return;
-    }
-
-    // memomry controller
-    if ((0x110200 <= cmd.offset && cmd.offset < 0x110200 + 0x1000 * 6) || cmd.offset == 0x10f20c) {
-        switch (cmd.offset) {
-            case 0x11020c:  // psize
-            case 0x11120c:
-            case 0x11220c:
-            case 0x11320c:
-            case 0x11420c:
-            case 0x11520c:
-            case 0x11620c:
-            case 0x10f20c:  // bsize (it should be equal to psize for uniform memory layout)
-                buffer()->value = A3_MEMORY_CTL_PART >> 20;
-                return;
-        }
-    }
-
-    registers::accessor regs;
-    buffer()->value = regs.read(cmd.offset, cmd.size());
+    buffer()->value = pfifo_.read(this, cmd);
 }
 
 // PCOPY channel inst decode
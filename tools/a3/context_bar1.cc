@@ -32,6 +32,20 @@
 #include "poll_area.h"
 namespace a3 {
 
+uint64_t context::translate_bar1(uint32_t offset, bool* is_barrier) {
+    uint64_t gphys = 0;
+    if (bar1_tlb()->lookup(offset, barrier()->generation(), &gphys, is_barrier)) {
+        return gphys;
+    }
+    gphys = bar1_channel()->table()->resolve(offset, nullptr);
+    if (gphys == UINT64_MAX) {
+        return gphys;
+    }
+    *is_barrier = barrier()->contains(gphys);
+    bar1_tlb()->insert(offset, barrier()->generation(), gphys, *is_barrier);
+    return gphys;
+}
+
 void context::write_bar1(const command& cmd) {
     if (poll_area_.in_range(this, cmd.offset)) {
         const poll_area_t::channel_and_offset_t res =
@@ -47,14 +61,13 @@ void context::write_bar1(const command& cmd) {
                     }
                 }
                 chan->submit(this, cmd);
-                A3_SYNCHRONIZED(device()->mutex()) {
-                    device()->fire(this, cmd);
-                }
+                // schedulers synchronize by themselves
+                device()->fire(this, cmd);
             }
             break;
 
         default:
-            A3_SYNCHRONIZED(device()->mutex()) {
+            A3_SYNCHRONIZED(device()->bar1()->mutex()) {
                 device()->bar1()->write(this, cmd);
             }
             break;
@@ -62,13 +75,12 @@ void context::write_bar1(const command& cmd) {
         return;
     }
 
-    const uint64_t gphys = bar1_channel()->table()->resolve(cmd.offset, nullptr);
+    bool is_barrier = false;
+    const uint64_t gphys = translate_bar1(cmd.offset, &is_barrier);
     A3_LOG("VM BAR1 write 0x%" PRIX32 " access => 0x%" PRIX64 "\n", cmd.offset, gphys);
     if (gphys != UINT64_MAX) {
-        pmem::accessor pmem;
-        pmem.write(gphys, cmd.value, cmd.size());
-        barrier::page_entry* entry = nullptr;
-        if (barrier()->lookup(gphys, &entry, false)) {
+        pmem::write(gphys, cmd.value, cmd.size());
+        if (is_barrier) {
             // found
             write_barrier(gphys, cmd);
         }
@@ -88,7 +100,7 @@ void context::read_bar1(const command& cmd) {
             break;
 
         default: {
-                A3_SYNCHRONIZED(device()->mutex()) {
+                A3_SYNCHRONIZED(device()->bar1()->mutex()) {
                     buffer()->value = device()->bar1()->read(this, cmd);
                 }
             }
@@ -97,14 +109,14 @@ void context::read_bar1(const command& cmd) {
         return;
     }
 
-    const uint64_t gphys = bar1_channel()->table()->resolve(cmd.offset, nullptr);
+    bool is_barrier = false;
+    const uint64_t gphys = translate_bar1(cmd.offset, &is_barrier);
     A3_LOG("VM BAR1 read 0x%" PRIX32 " access => 0x%" PRIX64 "\n", cmd.offset, gphys);
     if (gphys != UINT64_MAX) {
         pmem::accessor pmem;
         const uint32_t ret = pmem.read(gphys, cmd.size());
         buffer()->value = ret;
-        barrier::page_entry* entry = nullptr;
-        if (barrier()->lookup(gphys, &entry, false)) {
+        if (is_barrier) {
             // found
             read_barrier(gphys, cmd);
         }
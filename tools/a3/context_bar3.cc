@@ -31,13 +31,26 @@
 #include "device_bar3.h"
 namespace a3 {
 
+uint64_t context::translate_bar3(uint32_t offset, bool* is_barrier) {
+    uint64_t gphys = 0;
+    if (bar3_tlb()->lookup(offset, barrier()->generation(), &gphys, is_barrier)) {
+        return gphys;
+    }
+    gphys = device()->bar3()->resolve(this, offset, nullptr);
+    if (gphys == UINT64_MAX) {
+        return gphys;
+    }
+    *is_barrier = barrier()->contains(gphys);
+    bar3_tlb()->insert(offset, barrier()->generation(), gphys, *is_barrier);
+    return gphys;
+}
+
 void context::write_bar3(const command& cmd) {
-    const uint64_t gphys = device()->bar3()->resolve(this, cmd.offset, nullptr);
+    bool is_barrier = false;
+    const uint64_t gphys = translate_bar3(cmd.offset, &is_barrier);
     if (gphys != UINT64_MAX) {
-        pmem::accessor pmem;
-        pmem.write(gphys, cmd.value, cmd.size());
-        barrier::page_entry* entry = nullptr;
-        if (barrier()->lookup(gphys, &entry, false)) {
+        pmem::write(gphys, cmd.value, cmd.size());
+        if (is_barrier) {
             // found
             write_barrier(gphys, cmd);
         }
@@ -47,13 +60,13 @@ void context::write_bar3(const command& cmd) {
 }
 
 void context::read_bar3(const command& cmd) {
-    const uint64_t gphys = device()->bar3()->resolve(this, cmd.offset, nullptr);
+    bool is_barrier = false;
+    const uint64_t gphys = translate_bar3(cmd.offset, &is_barrier);
     if (gphys != UINT64_MAX) {
         pmem::accessor pmem;
         const uint32_t ret = pmem.read(gphys, cmd.size());
         buffer()->value = ret;
-        barrier::page_entry* entry = nullptr;
-        if (barrier()->lookup(gphys, &entry, false)) {
+        if (is_barrier) {
             // found
             read_barrier(gphys, cmd);
         }
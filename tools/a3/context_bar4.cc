@@ -22,6 +22,7 @@
  * THE SOFTWARE.
  */
 #include <cstdint>
+#include <vector>
 #include "a3.h"
 #include "context.h"
 #include "pmem.h"
@@ -35,6 +36,7 @@
 #include "pv_page.h"
 #include "device_bar1.h"
 #include "device_bar3.h"
+#include "p2m_cache.h"
 namespace a3 {
 namespace {
 
@@ -46,13 +48,14 @@ static uint64_t round_up(uint64_t x, uint64_t y) {
 
 int context::pv_map(pv_page* pgt, uint32_t index, uint64_t guest, uint64_t host) {
     if (pgt == pv_bar3_pgt_) {
-        A3_SYNCHRONIZED(device()->mutex()) {
+        A3_SYNCHRONIZED(device()->bar3()->mutex()) {
             device()->bar3()->pv_reflect(this, index, guest, host);
         }
         return 0;
     } else if (pgt == pv_bar1_large_pgt_) {
         bar1_channel()->table()->pv_reflect_entry(this, 0, true, index, guest);
-        A3_SYNCHRONIZED(device()->mutex()) {
+        bar1_tlb()->invalidate();
+        A3_SYNCHRONIZED(device()->bar1()->mutex()) {
             device()->bar1()->pv_reflect_entry(this, true, index, host);
         }
         // A3_UNREACHABLE();
@@ -63,7 +66,8 @@ int context::pv_map(pv_page* pgt, uint32_t index, uint64_t guest, uint64_t host)
         return 0;
     } else if (pgt == pv_bar1_small_pgt_) {
         bar1_channel()->table()->pv_reflect_entry(this, 0, false, index, guest);
-        A3_SYNCHRONIZED(device()->mutex()) {
+        bar1_tlb()->invalidate();
+        A3_SYNCHRONIZED(device()->bar1()->mutex()) {
             device()->bar1()->pv_reflect_entry(this, false, index, host);
         }
         return 0;
@@ -137,14 +141,16 @@ int context::a3_call(const command& cmd, slot_t* slot) {
                     // TODO(Yusuke Suzuki)
                     // set xen shadow for PV
                     bar1_channel()->table()->pv_scan(this, 0, true, pgt1);
-                    A3_SYNCHRONIZED(device()->mutex()) {
+                    bar1_tlb()->invalidate();
+                    A3_SYNCHRONIZED(device()->bar1()->mutex()) {
                         device()->bar1()->pv_scan(this);
                     }
                 }
                 if (pgt0 && pv_bar1_small_pgt_ != pgt0) {
                     pv_bar1_small_pgt_ = pgt0;
                     bar1_channel()->table()->pv_scan(this, 0, false, pgt0);
-                    A3_SYNCHRONIZED(device()->mutex()) {
+                    bar1_tlb()->invalidate();
+                    A3_SYNCHRONIZED(device()->bar1()->mutex()) {
                         device()->bar1()->pv_scan(this);
                     }
                 }
@@ -186,13 +192,14 @@ int context::a3_call(const command& cmd, slot_t* slot) {
                 A3_LOG("INVALID... [%u]\n", static_cast<unsigned>(slot->u32[1]));
                 return -EINVAL;
             }
+            p2m()->synchronize();
             // TODO(Yusuke Suzuki): validation
             const uint32_t index = slot->u32[2];
             const uint32_t next = slot->u32[3];
             const uint32_t count = slot->u32[4];
             uint64_t guest = slot->u64[3];
             if (pgt == pv_bar3_pgt_) {
-                A3_SYNCHRONIZED(device()->mutex()) {
+                A3_SYNCHRONIZED(device()->bar3()->mutex()) {
                     device()->bar3()->pv_reflect_batch(this, index, guest, next, count);
                 }
                 return 0;
@@ -217,9 +224,21 @@ int context::a3_call(const command& cmd, slot_t* slot) {
                 A3_LOG("INVALID... [%u]\n", static_cast<unsigned>(slot->u32[1]));
                 return -EINVAL;
             }
+            p2m()->synchronize();
             // TODO(Yusuke Suzuki): validation
             const uint32_t index = slot->u32[2];
             const uint32_t count = slot->u32[3];
+            // translate all system memory pages with batched hypercalls
+            std::vector<uint64_t> gfns;
+            gfns.reserve(count);
+            for (uint32_t i = 0; i < count; ++i) {
+                struct page_entry gpte;
+                gpte.raw = slot->u64[2 + i];
+                if (gpte.present && (gpte.target == page_entry::TARGET_TYPE_SYSRAM || gpte.target == page_entry::TARGET_TYPE_SYSRAM_NO_SNOOP)) {
+                    gfns.push_back((uint32_t)(gpte.address));
+                }
+            }
+            p2m()->prefetch(gfns);
             for (uint32_t i = 0; i < count; ++i) {
                 const uint64_t guest = slot->u64[2 + i];
                 struct page_entry gpte;
@@ -260,7 +279,7 @@ int context::a3_call(const command& cmd, slot_t* slot) {
             }
 
             if (pgd == pv_bar1_pgd_) {
-                A3_SYNCHRONIZED(device()->mutex()) {
+                A3_SYNCHRONIZED(device()->bar1()->mutex()) {
                     device()->bar1()->flush();
                 }
                 return 0;
@@ -268,7 +287,7 @@ int context::a3_call(const command& cmd, slot_t* slot) {
 
             if (pgd == pv_bar3_pgd_) {
                 A3_LOG("BAR3 flush\n");
-                A3_SYNCHRONIZED(device()->mutex()) {
+                A3_SYNCHRONIZED(device()->bar3()->mutex()) {
                     device()->bar3()->flush();
                     // pgd = device()->bar3()->directory();
                 }
@@ -276,18 +295,16 @@ int context::a3_call(const command& cmd, slot_t* slot) {
             }
 
             const uint32_t engine = slot->u32[2];
-            A3_SYNCHRONIZED(device()->mutex()) {
-                registers::accessor regs;
-                if (!regs.wait_ne(0x100c80, 0x00ff0000, 0x00000000)) {
-                    A3_LOG("INVALID...\n");
-                    return -EINVAL;
-                }
-                regs.write32(0x100cb8, pgd->address() >> 8);
-                regs.write32(0x100cbc, 0x80000000 | engine);
-                if (!regs.wait_eq(0x100c80, 0x00008000, 0x00008000)) {
-                    A3_LOG("INVALID...\n");
-                    return -EINVAL;
-                }
+            registers::accessor regs;
+            if (!regs.wait_ne(0x100c80, 0x00ff0000, 0x00000000)) {
+                A3_LOG("INVALID...\n");
+                return -EINVAL;
+            }
+            regs.write32(0x100cb8, pgd->address() >> 8);
+            regs.write32(0x100cbc, 0x80000000 | engine);
+            if (!regs.wait_eq(0x100c80, 0x00008000, 0x00008000)) {
+                A3_LOG("INVALID...\n");
+                return -EINVAL;
             }
         }
         return 0;
@@ -372,7 +389,7 @@ void context::read_bar4(const command& cmd) {
                 munmap(guest_, NOUVEAU_PV_SLOT_TOTAL);
                 guest_ = nullptr;
             }
-            A3_SYNCHRONIZED(device()->mutex()) {
+            A3_SYNCHRONIZED(device()->xen_mutex()) {
                 guest_ = reinterpret_cast<uint8_t*>(a3_xen_map_foreign_range(device()->xl_ctx(), domid(), NOUVEAU_PV_SLOT_TOTAL, PROT_READ | PROT_WRITE, gp >> 12));
             }
 
@@ -30,10 +30,13 @@
 #include "device.h"
 #include "pmem.h"
 #include "page.h"
+#include "shadow_page_table.h"
+#include "trace.h"
 #include "ignore_unused_variable_warning.h"
 namespace a3 {
 
 void context::write_barrier(uint64_t addr, const command& cmd) {
+    const uint64_t start = trace::enabled(trace::CATEGORY_BARRIER, trace::LEVEL_INFO) ? trace::now() : 0;
     const uint64_t page = bit_clear<barrier::kPAGE_BITS>(addr);
     const uint64_t rest = addr - page;
     A3_LOG("write barrier 0x%" PRIX64 " : page 0x%" PRIX64 " <= 0x%" PRIX32 "\n", addr, page, cmd.value);
@@ -42,16 +45,22 @@ void context::write_barrier(uint64_t addr, const command& cmd) {
     // TODO(Yusuke Suzuki): BAR1 & BAR3 shadow sync
     typedef context::channel_map::iterator iter_t;
     const std::pair<iter_t, iter_t> range = ramin_channel_map()->equal_range(page);
-    A3_SYNCHRONIZED(device()->mutex()) {
-        for (iter_t it = range.first; it != range.second; ++it) {
-            A3_LOG("write reflect shadow 0x%" PRIX64 " : rest 0x%" PRIX64 "\n", it->second->shadow_ramin()->address(), rest);
-            if (cmd.value) {
-                if (a3::flags::lazy_shadowing) {
-                    it->second->flush(this);
-                }
+    // channels are per context state, no device wide lock is needed
+    for (iter_t it = range.first; it != range.second; ++it) {
+        A3_LOG("write reflect shadow 0x%" PRIX64 " : rest 0x%" PRIX64 "\n", it->second->shadow_ramin()->address(), rest);
+        if (cmd.value) {
+            if (a3::flags::lazy_shadowing) {
+                it->second->flush(this);
             }
-            it->second->shadow_ramin()->write(rest, cmd.value, cmd.size());
         }
+        it->second->shadow_ramin()->write(rest, cmd.value, cmd.size());
+    }
+
+    // guest page tables, re-shadowed at the next TLB flush
+    typedef context::page_table_map::iterator table_iter_t;
+    const std::pair<table_iter_t, table_iter_t> tables = guest_page_table_map()->equal_range(page);
+    for (table_iter_t it = tables.first; it != tables.second; ++it) {
+        it->second->mark_dirty(addr);
     }
 
     // BAR3
@@ -66,6 +75,8 @@ void context::write_barrier(uint64_t addr, const command& cmd) {
         bar1_channel()->shadow(this);
     }
 
+    trace::record_event(trace::CATEGORY_BARRIER, trace::LEVEL_INFO, trace::EVENT_BARRIER_WRITE, id(), addr, cmd.value, start);
+
 //    switch (offset) {
 //    case 0x0200: {
 //            // lower 32bit
@@ -0,0 +1,78 @@
+/*
+ * A3 Context span writes
+ *
+ * Copyright (c) 2012-2013 Yusuke Suzuki
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <cstdint>
+#include <algorithm>
+#include "a3.h"
+#include "context.h"
+#include "pmem.h"
+#include "page_table.h"
+#include "barrier.h"
+#include "poll_area.h"
+#include "trace.h"
+namespace a3 {
+
+// Consecutive dword writes of a batch (memcpy by the guest). The address is
+// translated and the barrier is looked up once per page, and plain pages are
+// written with one PRAMIN lock held. Each write is traced like a command
+// handled by itself.
+void context::write_span(const command* entries, uint32_t count) {
+    const uint64_t start = trace::enabled(trace::CATEGORY_COMMAND, trace::LEVEL_INFO) ? trace::now() : 0;
+    const command::bar_t bar = entries[0].bar();
+    for (uint32_t i = 0; i < count;) {
+        const uint32_t offset = entries[i].offset;
+        const uint32_t last = i + std::min<uint32_t>(count - i, (kPAGE_SIZE - (offset & (kPAGE_SIZE - 1))) / sizeof(uint32_t));
+
+        if (through() || (bar == command::BAR1 && poll_area_.in_range(this, offset))) {
+            // through mode and the poll area take the usual path
+            for (; i < last; ++i) {
+                handle(entries[i]);
+            }
+            continue;
+        }
+
+        bool barriered = false;
+        const uint64_t gphys = (bar == command::BAR1) ? translate_bar1(offset, &barriered) : translate_bar3(offset, &barriered);
+        if (gphys != UINT64_MAX) {
+            if (barriered) {
+                for (uint32_t j = i; j < last; ++j) {
+                    const uint64_t addr = gphys + (j - i) * sizeof(uint32_t);
+                    pmem::write32(addr, entries[j].value);
+                    write_barrier(addr, entries[j]);
+                }
+            } else {
+                pmem::accessor pmem;
+                for (uint32_t j = i; j < last; ++j) {
+                    pmem.write32(gphys + (j - i) * sizeof(uint32_t), entries[j].value);
+                }
+            }
+        }
+        remap_barrier_changes();
+        for (; i < last; ++i) {
+            trace::record_command(id(), entries[i], 0, start);
+        }
+    }
+}
+
+}  // namespace a3
+/* vim: set sw=4 ts=4 et tw=80 : */
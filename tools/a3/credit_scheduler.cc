@@ -134,15 +134,11 @@ void credit_scheduler_t::submit(context* ctx) {
         ctx->dequeue(&cmd);
 
         utilization_.start();
-        A3_SYNCHRONIZED(device()->mutex()) {
+        A3_SYNCHRONIZED(device()->bar1()->mutex()) {
             device()->bar1()->write(ctx, cmd);
         }
 
-        while (device()->is_active(ctx)) {
-            boost::this_thread::yield();
-        }
-
-        const auto duration = utilization_.elapsed();
+        const auto duration = wait_completion(ctx, utilization_);
         bandwidth_ += duration;
         sampler_->add(duration);
         ctx->update_budget(duration);
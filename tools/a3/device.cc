@@ -21,6 +21,8 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
  */
+#include <atomic>
+#include <cinttypes>
 #include <cstdlib>
 #include <iostream>
 #include <unistd.h>
@@ -28,18 +30,20 @@
 #include <boost/asio.hpp>
 #include <boost/thread.hpp>
 #include <boost/container/detail/singleton.hpp>
-#include <pciaccess.h>
 #include "a3.h"
 #include "xen.h"
 #include "device.h"
 #include "vram.h"
-#include "mmio.h"
+#include "pci_backend.h"
+#include "simulated_backend.h"
 #include "context.h"
 #include "playlist.h"
 #include "registers.h"
+#include "pmem.h"
 #include "device_bar1.h"
 #include "device_bar3.h"
 #include "bit_mask.h"
+#include "mmio.h"
 #include "ignore_unused_variable_warning.h"
 #include "fifo_scheduler.h"
 #include "band_scheduler.h"
@@ -47,12 +51,6 @@
 #include "direct_scheduler.h"
 #include "assertion.h"
 
-#define NVC0_VENDOR 0x10DE
-#define NVC0_DEVICE 0x6D8
-#define NVC0_COMMAND 0x07
-#define NVC0_REVISION 0xA3
-#define PCI_COMMAND 0x04
-
 namespace a3 {
 
 static inline unsigned int pcidev_encode_bdf(libxl_device_pci *pcidev) {
@@ -66,13 +64,39 @@ static inline unsigned int pcidev_encode_bdf(libxl_device_pci *pcidev) {
     return value;
 }
 
+static uint32_t aperture_read(const uint8_t* ptr, std::size_t size) {
+    switch (size) {
+    case sizeof(uint8_t):
+        return mmio::read8(ptr);
+    case sizeof(uint16_t):
+        return mmio::read16(ptr);
+    }
+    return mmio::read32(ptr);
+}
+
+static void aperture_write(uint8_t* ptr, uint32_t val, std::size_t size) {
+    switch (size) {
+    case sizeof(uint8_t):
+        mmio::write8(val, ptr);
+        return;
+    case sizeof(uint16_t):
+        mmio::write16(val, ptr);
+        return;
+    }
+    mmio::write32(val, ptr);
+}
+
 device_t::device_t()
-    : device_()
+    : backend_()
+    , initialized_(false)
     , virts_(A3_VM_NUM, -1)
     , contexts_(A3_VM_NUM, nullptr)
-    , mutex_()
+    , mutex_(LOCK_RANK_DEVICE)
+    , pmem_mutex_(LOCK_RANK_PMEM)
+    , register_mutex_(LOCK_RANK_REGISTERS)
+    , xen_mutex_(LOCK_RANK_XEN)
     , pmem_()
-    , bars_()
+    , aperture_(nullptr)
     , bar1_()
     , bar3_()
     , vram_()
@@ -84,16 +108,6 @@ device_t::device_t()
     , xl_logger_()
     , xl_device_pci_()
 {
-    if (!(xl_logger_ = xtl_createlogger_stdiostream(stderr, XTL_PROGRESS,  0))) {
-        std::exit(1);
-    }
-
-    if (libxl_ctx_alloc(&xl_ctx_, LIBXL_VERSION, 0, (xentoollog_logger*)xl_logger_)) {
-        fprintf(stderr, "cannot init xl context\n");
-        std::exit(1);
-    }
-
-    A3_LOG("device environment setup\n");
 }
 
 device_t::~device_t() {
@@ -103,71 +117,34 @@ device_t::~device_t() {
     if (xl_logger_) {
         xtl_logger_destroy((xentoollog_logger*)xl_logger_);
     }
-    if (initialized()) {
-        pci_system_cleanup();
-    }
 }
 
 // not thread safe
 void device_t::initialize(const bdf& bdf) {
-    struct pci_id_match nvc0_match = {
-        NVC0_VENDOR,
-        PCI_MATCH_ANY,
-        PCI_MATCH_ANY,
-        PCI_MATCH_ANY,
-        0x30000,
-        0xFFFF0000,
-        0
-    };
-    int ret;
-
-    ret = pci_system_init();
-    ASSERT(!ret);
-    ignore_unused_variable_warning(ret);
-
-    struct pci_device_iterator* it = pci_id_match_iterator_create(&nvc0_match);
-    ASSERT(it);
-
-    struct pci_device* dev;
-    while ((dev = pci_device_next(it)) != nullptr) {
-        // search by BDF
-        if (dev->bus == bdf.bus && dev->dev == bdf.dev && dev->func == bdf.func) {
-            break;
-        }
+    if (flags::simulate) {
+        backend_.reset(new simulated_backend_t());
+    } else {
+        backend_.reset(new pci_backend_t());
     }
-    pci_iterator_destroy(it);
-
-    ASSERT(dev);
-    pci_device_enable(dev);
-    ret = pci_device_probe(dev);
-    ASSERT(!ret);
-
-    // And enable memory and io port.
-    // FIXME(Yusuke Suzuki)
-    // This is very ad-hoc code.
-    // We should cleanup and set precise command code in the future.
-    pci_device_cfg_write_u16(dev, NVC0_COMMAND, PCI_COMMAND);
-    device_ = dev;
-
-    // init BARs
-    void* addr;
-    ret = pci_device_map_range(dev, dev->regions[0].base_addr, dev->regions[0].size, PCI_DEV_MAP_FLAG_WRITABLE, &addr);
-    bars_[0].addr = addr;
-    bars_[0].base_addr = dev->regions[0].base_addr;
-    bars_[0].size = dev->regions[0].size;
-    ret = pci_device_map_range(dev, dev->regions[1].base_addr, dev->regions[1].size, PCI_DEV_MAP_FLAG_WRITABLE, &addr);
-    bars_[1].addr = addr;
-    bars_[1].base_addr = dev->regions[1].base_addr;
-    bars_[1].size = dev->regions[1].size;
-    ret = pci_device_map_range(dev, dev->regions[3].base_addr, dev->regions[3].size, PCI_DEV_MAP_FLAG_WRITABLE, &addr);
-    bars_[3].addr = addr;
-    bars_[3].base_addr = dev->regions[3].base_addr;
-    bars_[3].size = dev->regions[3].size;
-
-    if (!initialized()) {
-        pci_system_cleanup();
+
+    if (!backend_->initialize(bdf)) {
         return;
     }
+    initialized_ = true;
+
+    if (!simulated()) {
+        // simulated device has no Xen, xl_ctx() is nullptr
+        if (!(xl_logger_ = xtl_createlogger_stdiostream(stderr, XTL_PROGRESS,  0))) {
+            std::exit(1);
+        }
+
+        if (libxl_ctx_alloc(&xl_ctx_, LIBXL_VERSION, 0, (xentoollog_logger*)xl_logger_)) {
+            fprintf(stderr, "cannot init xl context\n");
+            std::exit(1);
+        }
+
+        A3_LOG("device environment setup\n");
+    }
 
     A3_LOG("PCI device catch\n");
 
@@ -178,22 +155,33 @@ void device_t::initialize(const bdf& bdf) {
     vram_.reset(new vram_manager_t(A3_HYPERVISOR_DEVICE_MEM_BASE, A3_HYPERVISOR_DEVICE_MEM_SIZE));
 
     // init bar1 device
-    bar1_.reset(new device_bar1(bars_[1]));
+    bar1_.reset(new device_bar1(backend_->bar(1)));
+
+    // map the head of the VRAM pool through the BAR1 aperture
+    // pages allocated before this point are accessed through PRAMIN
+    if (void* aperture = backend_->map_aperture(A3_BAR1_APERTURE_OFFSET, A3_HYPERVISOR_DEVICE_MEM_BASE, A3_BAR1_APERTURE_SIZE)) {
+        aperture_ = static_cast<uint8_t*>(aperture);
+        A3_LOG("BAR1 aperture 0x%" PRIX64 " mapped to VRAM 0x%" PRIX64 "\n", static_cast<uint64_t>(A3_BAR1_APERTURE_OFFSET), static_cast<uint64_t>(A3_HYPERVISOR_DEVICE_MEM_BASE));
+    } else {
+        A3_LOG("BAR1 aperture is not available, fallback to PRAMIN\n");
+    }
 
     // init bar3 device
-    bar3_.reset(new device_bar3(bars_[3]));
+    bar3_.reset(new device_bar3(backend_->bar(3)));
 
     // list assignable devices
-    int num = 0;
-    if (libxl_device_pci* pcidevs = libxl_device_pci_assignable_list(xl_ctx_, &num)) {
-        for (int i = 0; i < num; ++i) {
-            libxl_device_pci* pci = (pcidevs + i);
-            A3_LOG("PCI device: %02x:%02x.%02x => %d\n", pci->bus, pci->dev, pci->func, pci->domain);
-            if (pci->bus == bdf.bus && pci->dev == bdf.dev && pci->func == bdf.func) {
-                xl_device_pci_ = *pci;
+    if (xl_ctx_) {
+        int num = 0;
+        if (libxl_device_pci* pcidevs = libxl_device_pci_assignable_list(xl_ctx_, &num)) {
+            for (int i = 0; i < num; ++i) {
+                libxl_device_pci* pci = (pcidevs + i);
+                A3_LOG("PCI device: %02x:%02x.%02x => %d\n", pci->bus, pci->dev, pci->func, pci->domain);
+                if (pci->bus == bdf.bus && pci->dev == bdf.dev && pci->func == bdf.func) {
+                    xl_device_pci_ = *pci;
+                }
             }
+            std::free(pcidevs);
         }
-        std::free(pcidevs);
     }
 
     // init playlist
@@ -225,7 +213,7 @@ void device_t::initialize(const bdf& bdf) {
 }
 
 uint32_t device_t::acquire_virt(context* ctx) {
-    mutex_t::scoped_lock lock(mutex());
+    ranked_mutex_t::scoped_lock lock(mutex());
     const boost::dynamic_bitset<>::size_type pos = virts_.find_first();
     if (pos != virts_.npos) {
         virts_.set(pos, 0);
@@ -236,41 +224,36 @@ uint32_t device_t::acquire_virt(context* ctx) {
 }
 
 void device_t::release_virt(uint32_t virt, context* ctx) {
-    mutex_t::scoped_lock lock(mutex());
+    ranked_mutex_t::scoped_lock lock(mutex());
     virts_.set(virt, 1);
     scheduler_->unregister_context(ctx);
+    A3_SYNCHRONIZED(bar1()->mutex()) {
+        bar1()->release(virt);
+    }
+    A3_SYNCHRONIZED(bar3()->mutex()) {
+        bar3()->release(virt);
+    }
     contexts_[virt] = nullptr;
 }
 
 uint32_t device_t::read(int bar, uint32_t offset, std::size_t size) {
-    switch (size) {
-    case sizeof(uint8_t):
-        return mmio::read8(bars_[bar].addr, offset);
-    case sizeof(uint16_t):
-        return mmio::read16(bars_[bar].addr, offset);
-    case sizeof(uint32_t):
-        return mmio::read32(bars_[bar].addr, offset);
-    }
-    A3_LOG("%" PRIu64 " is invalid\n", size);
-    A3_UNREACHABLE();
-    return 0;
+    return backend_->read(bar, offset, size);
 }
 
 void device_t::write(int bar, uint32_t offset, uint32_t val, std::size_t size) {
-    switch (size) {
-    case sizeof(uint8_t):
-        mmio::write8(bars_[bar].addr, offset, val);
-        return;
-    case sizeof(uint16_t):
-        mmio::write16(bars_[bar].addr, offset, val);
-        return;
-    case sizeof(uint32_t):
-        mmio::write32(bars_[bar].addr, offset, val);
-        return;
+    if (bar != 3 && aperture_) {
+        // drain write combined aperture stores before a register or
+        // doorbell write lets the device look at the structures
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+    backend_->write(bar, offset, val, size);
+}
+
+uint8_t* device_t::aperture(uint64_t addr, std::size_t size) const {
+    if (!aperture_ || addr < A3_HYPERVISOR_DEVICE_MEM_BASE || (addr + size) > (A3_HYPERVISOR_DEVICE_MEM_BASE + A3_BAR1_APERTURE_SIZE)) {
+        return nullptr;
     }
-    A3_LOG("%" PRIu64 " is invalid\n", size);
-    A3_UNREACHABLE();
-    return;
+    return aperture_ + (addr - A3_HYPERVISOR_DEVICE_MEM_BASE);
 }
 
 vram_t* device_t::malloc(std::size_t n) {
@@ -284,7 +267,9 @@ void device_t::free(vram_t* mem) {
 }
 
 bool device_t::is_active(context* ctx) {
-    return registers::read32(0x400700);
+    // PGRAPH status. A single read is not part of a register sequence, so
+    // the scheduler polls it without the registers lock.
+    return read(0, 0x400700, sizeof(uint32_t));
 }
 
 void device_t::fire(context* ctx, const command& cmd) {
@@ -297,27 +282,37 @@ void device_t::playlist_update(context* ctx, uint32_t address, uint32_t cmd) {
     }
 }
 
+// called with pmem_mutex
+void device_t::switch_pmem(uint64_t addr) {
+    pmem::statistics_t* statistics = pmem::statistics();
+    statistics->accesses.fetch_add(1, std::memory_order_relaxed);
+    const uint32_t shifted = pmem::window(addr);
+    if (shifted != pmem_) {
+        // change pmem
+        pmem_ = shifted;
+        write(0, 0x1700, shifted, sizeof(uint32_t));
+        statistics->switches.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
 uint32_t device_t::read_pmem(uint64_t addr, std::size_t size) {
-    A3_SYNCHRONIZED(mutex()) {
-        const uint64_t shifted = ((addr & 0xffffff00000ULL) >> 16);
-        if (shifted != pmem_) {
-            // change pmem
-            pmem_ = shifted;
-            write(0, 0x1700, shifted, sizeof(uint32_t));
-        }
+    if (uint8_t* ptr = aperture(addr, size)) {
+        return aperture_read(ptr, size);
+    }
+    A3_SYNCHRONIZED(pmem_mutex()) {
+        switch_pmem(addr);
         return read(0, 0x700000 + (addr & 0x000000fffffULL), size);
     }
     return 0;  // make compiler happy
 }
 
 void device_t::write_pmem(uint64_t addr, uint32_t val, std::size_t size) {
-    A3_SYNCHRONIZED(mutex()) {
-        const uint64_t shifted = ((addr & 0xffffff00000ULL) >> 16);
-        if (shifted != pmem_) {
-            // change pmem
-            pmem_ = shifted;
-            write(0, 0x1700, shifted, sizeof(uint32_t));
-        }
+    if (uint8_t* ptr = aperture(addr, size)) {
+        aperture_write(ptr, val, size);
+        return;
+    }
+    A3_SYNCHRONIZED(pmem_mutex()) {
+        switch_pmem(addr);
         write(0, 0x700000 + (addr & 0x000000fffffULL), val, size);
     }
 }
@@ -3,7 +3,6 @@
 #include <vector>
 #include <array>
 #include <memory>
-#include <pciaccess.h>
 #include <boost/dynamic_bitset.hpp>
 #include <boost/noncopyable.hpp>
 #include "a3.h"
@@ -11,6 +10,7 @@
 #include "lock.h"
 #include "session.h"
 #include "chipset.h"
+#include "device_backend.h"
 namespace a3 {
 
 class device_bar1;
@@ -23,11 +23,7 @@ class scheduler_t;
 
 class device_t : private boost::noncopyable {
  public:
-    struct bar_t {
-        void* addr;
-        uintptr_t base_addr;
-        std::size_t size;
-    };
+    typedef device_bar_t bar_t;
 
     friend class device_bar1;
     friend class device_bar3;
@@ -36,14 +32,22 @@ class device_t : private boost::noncopyable {
     ~device_t();
     void initialize(const bdf& bdf);
     static device_t* instance();
-    bool initialized() const { return device_; }
+    bool initialized() const { return initialized_; }
+    bool simulated() const { return backend_ && backend_->simulated(); }
     uint32_t acquire_virt(context* ctx);
     void release_virt(uint32_t virt, context* ctx);
-    mutex_t& mutex() { return mutex_; }
+    // see lock.h for the lock order
+    ranked_mutex_t& mutex() { return mutex_; }
+    ranked_mutex_t& pmem_mutex() { return pmem_mutex_; }
+    ranked_mutex_t& register_mutex() { return register_mutex_; }
+    ranked_mutex_t& xen_mutex() { return xen_mutex_; }
     uint32_t read(int bar, uint32_t offset, std::size_t size);
     void write(int bar, uint32_t offset, uint32_t val, std::size_t size);
     uint32_t read_pmem(uint64_t addr, std::size_t size);
     void write_pmem(uint64_t addr, uint32_t val, std::size_t size);
+    // CPU mapping of VRAM [addr, addr + size) through the BAR1 aperture,
+    // nullptr if it is not covered. Accesses need no pmem lock
+    uint8_t* aperture(uint64_t addr, std::size_t size) const;
     uint32_t pmem() const { return pmem_; }
     void set_pmem(uint32_t pmem) { pmem_ = pmem; }
     device_bar1* bar1() { return bar1_.get(); }
@@ -65,12 +69,18 @@ class device_t : private boost::noncopyable {
     libxl_ctx* xl_ctx() const { return xl_ctx_; }
 
  private:
-    struct pci_device* device_;
+    void switch_pmem(uint64_t addr);
+
+    std::unique_ptr<device_backend_t> backend_;
+    bool initialized_;
     boost::dynamic_bitset<> virts_;
     std::vector<context*> contexts_;
-    mutex_t mutex_;
+    ranked_mutex_t mutex_;
+    ranked_mutex_t pmem_mutex_;
+    ranked_mutex_t register_mutex_;
+    ranked_mutex_t xen_mutex_;
     uint32_t pmem_;
-    std::array<bar_t, 5> bars_;
+    uint8_t* aperture_;
     std::unique_ptr<device_bar1> bar1_;
     std::unique_ptr<device_bar3> bar3_;
     std::unique_ptr<vram_manager_t> vram_;
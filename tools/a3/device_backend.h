@@ -0,0 +1,34 @@
+#ifndef A3_DEVICE_BACKEND_H_
+#define A3_DEVICE_BACKEND_H_
+#include <cstddef>
+#include <cstdint>
+#include <boost/noncopyable.hpp>
+#include "a3.h"
+namespace a3 {
+
+struct device_bar_t {
+    void* addr;
+    uintptr_t base_addr;
+    std::size_t size;
+};
+
+// Backend of device_t. All BAR accesses of A3 go through read / write.
+// pci_backend_t drives the real GPU, and simulated_backend_t emulates NVC0
+// in memory, so A3 can run without hardware.
+class device_backend_t : private boost::noncopyable {
+ public:
+    virtual ~device_backend_t() { }
+    virtual bool simulated() const = 0;
+    // returns false if the device is not found
+    virtual bool initialize(const bdf& bdf) = 0;
+    virtual const device_bar_t& bar(int index) const = 0;
+    virtual uint32_t read(int bar, uint32_t offset, std::size_t size) = 0;
+    virtual void write(int bar, uint32_t offset, uint32_t val, std::size_t size) = 0;
+    // CPU mapping of BAR1 [offset, offset + size), which A3 has mapped to
+    // VRAM [vram, vram + size). returns nullptr if it cannot be mapped
+    virtual void* map_aperture(uint64_t offset, uint64_t vram, std::size_t size) = 0;
+};
+
+}  // namespace a3
+#endif  // A3_DEVICE_BACKEND_H_
+/* vim: set sw=4 ts=4 et tw=80 : */
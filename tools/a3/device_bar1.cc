@@ -23,6 +23,7 @@
  */
 #include <cstdint>
 #include <cinttypes>
+#include <algorithm>
 #include "bit_mask.h"
 #include "device_table.h"
 #include "pmem.h"
@@ -32,17 +33,31 @@
 #include "context.h"
 #include "mmio.h"
 #include "registers.h"
+#include "barrier.h"
+#include "flags.h"
+#include "xen.h"
 namespace a3 {
 
+static_assert((A3_BAR1_APERTURE_OFFSET + A3_BAR1_APERTURE_SIZE) <= kPAGE_DIRECTORY_COVERED_SIZE, "BAR1 aperture is covered by the first page directory");
+static_assert(A3_BAR1_POLL_AREA_SIZE <= A3_BAR1_APERTURE_OFFSET, "BAR1 aperture does not overlap with the poll area");
+static_assert((A3_BAR1_ARENA_OFFSET + A3_BAR1_ARENA_SIZE * A3_VM_NUM) <= A3_BAR1_APERTURE_OFFSET, "BAR1 arenas do not overlap with the aperture");
+
+static const uint64_t kARENA_PAGES = A3_BAR1_ARENA_SIZE / kSMALL_PAGE_SIZE;
+
 device_bar1::device_bar1(device_t::bar_t bar)
-    : ramin_(1)
+    : mutex_(LOCK_RANK_BAR1)
+    , address_(bar.base_addr)
+    , ramin_(1)
     , directory_(8)
-    , entry_()
+    , entry_((A3_BAR1_APERTURE_OFFSET + A3_BAR1_APERTURE_SIZE) / kSMALL_PAGE_SIZE * 0x8 / kPAGE_SIZE)
     , range_(device()->chipset()->type() == card::NVC0 ? 0x001000 : 0x000200)
+    , software_(kARENA_PAGES * A3_VM_NUM)
+    , xen_("BAR1", a3::flags::bar1_remapping, bar.base_addr + A3_BAR1_ARENA_OFFSET, kARENA_PAGES, kARENA_PAGES * A3_VM_NUM)
     {
     const uint64_t vm_size = (range_ * 128) - 1;
     ramin_.clear();
     directory_.clear();
+    entry_.clear();
 
     // construct channel ramin
     mmio::write64(&ramin_, 0x0200, directory_.address());
@@ -56,9 +71,17 @@ device_bar1::device_bar1(device_t::bar_t bar)
     directory_.write32(0x0, dir.word0);
     directory_.write32(0x4, dir.word1);
 
+    // map the head of the VRAM pool to the aperture
+    for (uint64_t offset = 0; offset < A3_BAR1_APERTURE_SIZE; offset += kSMALL_PAGE_SIZE) {
+        const uint64_t index = (A3_BAR1_APERTURE_OFFSET + offset) / kSMALL_PAGE_SIZE;
+        entry_.write32(0x8 * index, (A3_HYPERVISOR_DEVICE_MEM_BASE + offset) >> 8 | 0x1);
+        entry_.write32(0x8 * index + 0x4, 0);  // VRAM
+    }
+
     // refresh_channel();
     refresh_poll_area();
     refresh();
+    flush();
 
     A3_LOG("construct shadow BAR1 channel %" PRIX64 " with PDE %" PRIX64 " PTE %" PRIX64 " \n", ramin_.address(), directory_.address(), entry_.address());
 }
@@ -89,6 +112,7 @@ void device_bar1::shadow(context* ctx) {
             map(virt, entry.phys());
         }
     }
+    remap(ctx);
 }
 
 void device_bar1::map(uint64_t virt, const struct page_entry& entry) {
@@ -103,7 +127,7 @@ void device_bar1::map(uint64_t virt, const struct page_entry& entry) {
 }
 
 void device_bar1::flush() {
-    A3_SYNCHRONIZED(device()->mutex()) {
+    A3_SYNCHRONIZED(mutex()) {
         const uint32_t engine = 1 | 4;
         registers::accessor registers;
         registers.wait_ne(0x100c80, 0x00ff0000, 0x00000000);
@@ -137,6 +161,7 @@ void device_bar1::pv_scan(context* ctx) {
             map(virt, entry.phys());
         }
     }
+    remap(ctx);
 }
 
 void device_bar1::pv_reflect_entry(context* ctx, bool big, uint32_t index, uint64_t host) {
@@ -144,9 +169,102 @@ void device_bar1::pv_reflect_entry(context* ctx, bool big, uint32_t index, uint6
     struct page_entry entry;
     entry.raw = host;
     if (big) {
+        remap(ctx, index * (kLARGE_PAGE_SIZE / kSMALL_PAGE_SIZE), kLARGE_PAGE_SIZE / kSMALL_PAGE_SIZE);
     } else {
         map(((ctx->id() * A3_DOMAIN_CHANNELS) + index) * range_, entry);
+        remap(ctx, index, 1);
+    }
+}
+
+void device_bar1::remap(context* ctx) {
+    remap(ctx, 0, kARENA_PAGES);
+}
+
+void device_bar1::remap(context* ctx, uint64_t first, uint64_t count) {
+    if (!a3::flags::bar1_remapping || !ctx->bar1_address() || !ctx->bar1_channel() || first >= kARENA_PAGES) {
+        return;
     }
+    count = std::min(count, kARENA_PAGES - first);
+    const uint64_t shift = ctx->id() * kARENA_PAGES;
+    bool changed = false;
+    for (uint64_t index = first; index < first + count; ++index) {
+        const uint64_t virt = index * kSMALL_PAGE_SIZE;
+        const uint64_t hindex = shift + index;
+        struct software_page_entry gentry;
+        struct page_entry entry = { };
+        a3_xen_mapping_t mapping = A3_XEN_UNMAPPED;
+        const uint64_t gphys = ctx->bar1_channel()->table()->resolve(virt, &gentry);
+        if (gphys != UINT64_MAX) {
+            // large pages are split into small pages
+            entry = gentry.phys();
+            entry.address = gphys >> 12;
+            if (!ctx->poll_area()->in_range(ctx, virt)) {
+                // guest reads of barrier pages go to the device, writes are trapped
+                const bool barriered = entry.target == page_entry::TARGET_TYPE_VRAM && ctx->barrier()->contains(gphys);
+                mapping = barriered ? A3_XEN_READ_ONLY : A3_XEN_MAPPED;
+            }
+        }
+
+        if (software_[hindex] != entry.raw) {
+            software_[hindex] = entry.raw;
+            map(A3_BAR1_ARENA_OFFSET + hindex * kSMALL_PAGE_SIZE, entry);
+            changed = true;
+        }
+        xen_.map(ctx, ctx->bar1_address(), index, 1, mapping);
+    }
+    xen_.flush(ctx);
+
+    if (changed) {
+        flush();
+    }
+}
+
+void device_bar1::reset_barrier(context* ctx, uint64_t old, uint64_t addr) {
+    if (!a3::flags::bar1_remapping) {
+        return;
+    }
+    const uint64_t shift = ctx->id() * kARENA_PAGES;
+    for (uint64_t index = 0; index < kARENA_PAGES; ++index) {
+        struct page_entry entry;
+        entry.raw = software_[shift + index];
+        if (!entry.present || entry.target != page_entry::TARGET_TYPE_VRAM) {
+            continue;
+        }
+        const uint64_t page = static_cast<uint64_t>(entry.address) << 12;
+        if (page == old || page == addr) {
+            remap(ctx, index, 1);
+        }
+    }
+}
+
+void device_bar1::remap_barriers(context* ctx, const std::vector<uint64_t>& pages) {
+    if (!a3::flags::bar1_remapping) {
+        return;
+    }
+    const uint64_t shift = ctx->id() * kARENA_PAGES;
+    for (uint64_t index = 0; index < kARENA_PAGES; ++index) {
+        struct page_entry entry;
+        entry.raw = software_[shift + index];
+        if (!entry.present || entry.target != page_entry::TARGET_TYPE_VRAM) {
+            continue;
+        }
+        const uint64_t page = static_cast<uint64_t>(entry.address) << 12;
+        if (std::binary_search(pages.begin(), pages.end(), page)) {
+            remap(ctx, index, 1);
+        }
+    }
+}
+
+void device_bar1::unmap_xen_pages(context* ctx) {
+    if (!a3::flags::bar1_remapping || !ctx->bar1_address()) {
+        return;
+    }
+    xen_.map(ctx, ctx->bar1_address(), 0, kARENA_PAGES, A3_XEN_UNMAPPED);
+    xen_.flush(ctx);
+}
+
+void device_bar1::release(uint32_t id) {
+    xen_.release(id);
 }
 
 }  // namespace a3
@@ -1,12 +1,14 @@
 #ifndef A3_DEVICE_BAR1_H_
 #define A3_DEVICE_BAR1_H_
 #include <memory>
+#include <vector>
 #include <boost/noncopyable.hpp>
 #include "a3.h"
 #include "page.h"
 #include "page_table.h"
 #include "device.h"
 #include "size.h"
+#include "arena_mappings.h"
 namespace a3 {
 
 class context;
@@ -20,6 +22,7 @@ class device_bar1 : private boost::noncopyable {
  public:
     device_bar1(device_t::bar_t bar);
     uint64_t address() const { return directory_.address(); }
+    ranked_mutex_t& mutex() { return mutex_; }
     void refresh();
     void refresh_poll_area();
     void shadow(context* ctx);
@@ -29,13 +32,29 @@ class device_bar1 : private boost::noncopyable {
     void pv_scan(context* ctx);
     void pv_reflect_entry(context* ctx, bool big, uint32_t index, uint64_t entry);
 
+    // BAR1 remapping
+    // Mirrors guest BAR1 pages [first, first + count) of the head of the
+    // guest BAR1 space into the arena of ctx, and maps them into the guest.
+    // Barrier pages are mapped read-only and poll area pages stay trapped.
+    void remap(context* ctx);
+    void remap(context* ctx, uint64_t first, uint64_t count);
+    void reset_barrier(context* ctx, uint64_t old, uint64_t addr);
+    // remaps arena pages aliasing the sorted pages
+    void remap_barriers(context* ctx, const std::vector<uint64_t>& pages);
+    void unmap_xen_pages(context* ctx);
+    void release(uint32_t id);
+
  private:
     void map(uint64_t virt, const struct page_entry& entry);
 
+    ranked_mutex_t mutex_;
+    uintptr_t address_;
     page ramin_;
     page directory_;
     page entry_;
     uint64_t range_;
+    std::vector<uint64_t> software_;  // arena PTEs of all VMs
+    arena_mappings_t xen_;            // arena pages mapped into the guest
 };
 
 }  // namespace a3
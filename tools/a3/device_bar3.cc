@@ -22,7 +22,7 @@
  * THE SOFTWARE.
  */
 #include <cstdint>
-#include <boost/logic/tribool.hpp>
+#include <algorithm>
 #include "device.h"
 #include "device_bar3.h"
 #include "context.h"
@@ -37,7 +37,8 @@
 namespace a3 {
 
 device_bar3::device_bar3(device_t::bar_t bar)
-    : address_(bar.base_addr)
+    : mutex_(LOCK_RANK_BAR3)
+    , address_(bar.base_addr)
     , size_(bar.size)
     , ramin_(1)
     , directory_(8)
@@ -45,6 +46,7 @@ device_bar3::device_bar3(device_t::bar_t bar)
     , software_(A3_BAR3_TOTAL_SIZE / 0x8)
     , large_()
     , small_()
+    , xen_("BAR3", a3::flags::bar3_remapping, bar.base_addr, A3_BAR3_ARENA_SIZE / kPAGE_SIZE, A3_BAR3_TOTAL_SIZE / kPAGE_SIZE)
 {
     ramin_.clear();
     directory_.clear();
@@ -68,40 +70,37 @@ void device_bar3::refresh() {
     registers::write32(0x001714, 0xc0000000 | ramin_.address() >> 12);
 }
 
-void device_bar3::map_xen_page(context* ctx, uint64_t offset) {
-    const uint64_t guest = ctx->bar3_address() + offset;
-    const uint64_t host = address() + ctx->id() * A3_BAR3_ARENA_SIZE + offset;
-    // A3_LOG("mapping %" PRIx64 " to %" PRIx64 "\n", guest, host);
-    if (a3::flags::bar3_remapping) {
-        a3_xen_add_memory_mapping(device()->xl_ctx(), ctx->domid(), guest >> kPAGE_SHIFT, host >> kPAGE_SHIFT, 1);
-    }
+// Queues the Xen mapping change of arena pages [offset, offset + count).
+// xen_.flush issues the queue.
+void device_bar3::map_xen_pages(context* ctx, uint64_t offset, uint32_t count, a3_xen_mapping_t mapping) {
+    xen_.map(ctx, ctx->bar3_address(), offset / kPAGE_SIZE, count, mapping);
 }
 
-void device_bar3::unmap_xen_page(context* ctx, uint64_t offset) {
-    const uint64_t guest = ctx->bar3_address() + offset;
-    const uint64_t host = address() + ctx->id() * A3_BAR3_ARENA_SIZE + offset;
-    // A3_LOG("unmapping %" PRIx64 " to %" PRIx64 "\n", guest, host);
-    if (a3::flags::bar3_remapping) {
-        a3_xen_remove_memory_mapping(device()->xl_ctx(), ctx->domid(), guest >> kPAGE_SHIFT, host >> kPAGE_SHIFT, 1);
-    }
+void device_bar3::release(uint32_t id) {
+    xen_.release(id);
 }
 
-void device_bar3::map_xen_page_batch(context* ctx, uint64_t offset, uint32_t count) {
-    const uint64_t guest = ctx->bar3_address() + offset;
-    const uint64_t host = address() + ctx->id() * A3_BAR3_ARENA_SIZE + offset;
-    A3_LOG("batch mapping %" PRIx64 " to %" PRIx64 " %" PRIu32 "\n", guest, host, count);
-    if (a3::flags::bar3_remapping) {
-        a3_xen_add_memory_mapping(device()->xl_ctx(), ctx->domid(), guest >> kPAGE_SHIFT, host >> kPAGE_SHIFT, count);
-    }
+// Drops the Xen mappings of the arena at the current guest BAR3 location.
+void device_bar3::unmap_xen_pages(context* ctx) {
+    map_xen_pages(ctx, 0, A3_BAR3_ARENA_SIZE / kPAGE_SIZE, A3_XEN_UNMAPPED);
+    xen_.flush(ctx);
 }
 
-void device_bar3::unmap_xen_page_batch(context* ctx, uint64_t offset, uint32_t count) {
-    const uint64_t guest = ctx->bar3_address() + offset;
-    const uint64_t host = address() + ctx->id() * A3_BAR3_ARENA_SIZE + offset;
-    A3_LOG("batch unmapping %" PRIx64 " to %" PRIx64 " %" PRIu32 "\n", guest, host, count);
-    if (a3::flags::bar3_remapping) {
-        a3_xen_remove_memory_mapping(device()->xl_ctx(), ctx->domid(), guest >> kPAGE_SHIFT, host >> kPAGE_SHIFT, count);
+// Maps the shadowed arena pages at the current guest BAR3 location.
+void device_bar3::remap(context* ctx) {
+    if (!ctx->bar3_address()) {
+        return;
+    }
+    const uint64_t shift = ctx->id() * A3_BAR3_ARENA_SIZE / kPAGE_SIZE;
+    for (uint64_t index = 0, iz = A3_BAR3_ARENA_SIZE / kPAGE_SIZE; index < iz; ++index) {
+        const uint64_t target = software_[shift + index];
+        a3_xen_mapping_t mapping = A3_XEN_UNMAPPED;
+        if (target) {
+            mapping = ctx->barrier()->contains(target) ? A3_XEN_READ_ONLY : A3_XEN_MAPPED;
+        }
+        map_xen_pages(ctx, index * kPAGE_SIZE, 1, mapping);
     }
+    xen_.flush(ctx);
 }
 
 void device_bar3::map(uint64_t index, const struct page_entry& entry) {
@@ -113,10 +112,6 @@ void device_bar3::map(uint64_t index, const struct page_entry& entry) {
 
 void device_bar3::shadow(context* ctx, uint64_t phys) {
     A3_LOG("%" PRIu32 " BAR3 shadowed\n", ctx->id());
-    // At first remove all
-    unmap_xen_page_batch(ctx, 0, A3_BAR3_ARENA_SIZE / 0x1000);
-
-    // FIXME(Yusuke Suzuki): optimize it
     for (uint64_t address = 0; address < A3_BAR3_ARENA_SIZE; address += kPAGE_SIZE) {
         const uint64_t virt = ctx->id() * A3_BAR3_ARENA_SIZE + address;
         struct software_page_entry entry;
@@ -124,19 +119,20 @@ void device_bar3::shadow(context* ctx, uint64_t phys) {
         const uint64_t index = virt / kPAGE_SIZE;
         if (gphys != UINT64_MAX) {
             // check this is not ramin
-            barrier::page_entry* barrier_entry = nullptr;
             map(index, entry.phys());
-            if (ctx->barrier()->lookup(gphys, &barrier_entry, false)) {
-                // unmap_xen_page(ctx, address);
+            if (ctx->barrier()->contains(gphys)) {
+                // guest reads go to the device, writes are trapped
+                map_xen_pages(ctx, address, 1, A3_XEN_READ_ONLY);
             } else {
-                map_xen_page(ctx, address);
+                map_xen_pages(ctx, address, 1, A3_XEN_MAPPED);
             }
         } else {
             const struct page_entry entry = { };
             map(index, entry);
-            // unmap_xen_page(ctx, address);
+            map_xen_pages(ctx, address, 1, A3_XEN_UNMAPPED);
         }
     }
+    xen_.flush(ctx);
 }
 
 void device_bar3::reset_barrier(context* ctx, uint64_t old, uint64_t addr, bool old_remap) {
@@ -145,15 +141,30 @@ void device_bar3::reset_barrier(context* ctx, uint64_t old, uint64_t addr, bool
         const uint64_t hindex = shift + index;
         const uint64_t target = software_[hindex];
         if (target == old && old_remap) {
-            map_xen_page(ctx, index * kPAGE_SIZE);
+            map_xen_pages(ctx, index * kPAGE_SIZE, 1, A3_XEN_MAPPED);
         } else if (target == addr) {
-            unmap_xen_page(ctx, index * kPAGE_SIZE);
+            map_xen_pages(ctx, index * kPAGE_SIZE, 1, A3_XEN_READ_ONLY);
         }
     }
+    xen_.flush(ctx);
+}
+
+void device_bar3::remap_barriers(context* ctx, const std::vector<uint64_t>& pages) {
+    if (!a3::flags::bar3_remapping || !ctx->bar3_address()) {
+        return;
+    }
+    const uint64_t shift = ctx->id() * A3_BAR3_ARENA_SIZE / kPAGE_SIZE;
+    for (uint64_t index = 0, iz = A3_BAR3_ARENA_SIZE / kPAGE_SIZE; index < iz; ++index) {
+        const uint64_t target = software_[shift + index];
+        if (target && std::binary_search(pages.begin(), pages.end(), target)) {
+            map_xen_pages(ctx, index * kPAGE_SIZE, 1, ctx->barrier()->contains(target) ? A3_XEN_READ_ONLY : A3_XEN_MAPPED);
+        }
+    }
+    xen_.flush(ctx);
 }
 
 void device_bar3::flush() {
-    A3_SYNCHRONIZED(device()->mutex()) {
+    A3_SYNCHRONIZED(mutex()) {
         const uint32_t engine = 1 | 4;
         registers::accessor registers;
         registers.write32(0x100cb8, directory_.address() >> 8);
@@ -209,32 +220,28 @@ void device_bar3::pv_reflect(context* ctx, uint32_t index, uint64_t guest, uint6
 
     entry.raw = guest;
     small_[hindex].refresh(ctx, entry);
+    ctx->bar3_tlb()->invalidate();
 
     entry.raw = host;
 
     if (host) {
         // check this is not ramin
-        barrier::page_entry* barrier_entry = nullptr;
         const uint64_t gphys = static_cast<uint64_t>(entry.address) << 12;
         map(hindex, entry);
-        if (!ctx->barrier()->lookup(gphys, &barrier_entry, false)) {
-            map_xen_page(ctx, goffset);
+        if (!ctx->barrier()->contains(gphys)) {
+            map_xen_pages(ctx, goffset, 1, A3_XEN_MAPPED);
         } else {
-            unmap_xen_page(ctx, goffset);
+            map_xen_pages(ctx, goffset, 1, A3_XEN_READ_ONLY);
         }
     } else {
         map(hindex, entry);
-        unmap_xen_page(ctx, goffset);
+        map_xen_pages(ctx, goffset, 1, A3_XEN_UNMAPPED);
     }
+    xen_.flush(ctx);
 }
 
 void device_bar3::pv_reflect_batch(context* ctx, uint32_t index, uint64_t guest, uint64_t next, uint32_t count) {
-    // mode true          => map
-    //      false         => unmap
-    //      indeterminate => init
-    boost::logic::tribool mode = boost::logic::indeterminate;
-    int32_t range = -1;
-    uint64_t init_page = -1;
+    ctx->bar3_tlb()->invalidate();
     for (uint32_t i = 0; i < count; ++i, guest += next) {
         const uint64_t hindex = index + i + ((ctx->id() * A3_BAR3_ARENA_SIZE) / kPAGE_SIZE);
         const uint64_t goffset = ((index + i) * kPAGE_SIZE);
@@ -243,48 +250,14 @@ void device_bar3::pv_reflect_batch(context* ctx, uint32_t index, uint64_t guest,
         small_[hindex].refresh(ctx, gentry);
         const struct page_entry entry = ctx->guest_to_host(gentry);
         map(hindex, entry);
+        a3_xen_mapping_t mapping = A3_XEN_UNMAPPED;
         if (entry.raw) {
-            barrier::page_entry* barrier_entry = nullptr;
             const uint64_t gphys = static_cast<uint64_t>(entry.address) << 12;
-            if (!ctx->barrier()->lookup(gphys, &barrier_entry, false)) {
-                // map
-                if (mode) {
-                    // map continues, increment range
-                    ++range;
-                    continue;
-                }
-
-                if (!mode) {
-                    // flush unmapping
-                    unmap_xen_page_batch(ctx, init_page, range);
-                }
-                mode = true;
-                init_page = goffset;
-                range = 1;
-                continue;
-            }
+            mapping = ctx->barrier()->contains(gphys) ? A3_XEN_READ_ONLY : A3_XEN_MAPPED;
         }
-
-        // unmap
-        if (!mode) {
-            ++range;
-            continue;
-        }
-
-        if (mode) {
-            map_xen_page_batch(ctx, init_page, range);
-        }
-        mode = false;
-        init_page = goffset;
-        range = 1;
-    }
-
-    // flush
-    if (mode) {
-        map_xen_page_batch(ctx, init_page, range);
-    } else if (!mode) {
-        unmap_xen_page_batch(ctx, init_page, range);
+        map_xen_pages(ctx, goffset, 1, mapping);
     }
+    xen_.flush(ctx);
 }
 
 void device_bar3::refresh_table(context* ctx, uint64_t phys) {
@@ -292,6 +265,7 @@ void device_bar3::refresh_table(context* ctx, uint64_t phys) {
     if (!phys) {
         return;
     }
+    ctx->bar3_tlb()->invalidate();
 
     // TODO(Yusuke Suzuki): validation needed
     struct page_directory dir = page_directory::create(&pmem, phys);
@@ -10,6 +10,7 @@
 #include "page_table.h"
 #include "size.h"
 #include "software_page_table.h"
+#include "arena_mappings.h"
 namespace a3 {
 
 class context;
@@ -19,10 +20,13 @@ class device_bar3 : private boost::noncopyable {
     friend class device;
 
     device_bar3(device_t::bar_t bar);
+    ranked_mutex_t& mutex() { return mutex_; }
     void refresh();
     void refresh_table(context* ctx, uint64_t phys);
     void shadow(context* ctx, uint64_t phys);
     void reset_barrier(context* ctx, uint64_t old, uint64_t addr, bool old_remap);
+    // remaps arena pages aliasing the sorted pages
+    void remap_barriers(context* ctx, const std::vector<uint64_t>& pages);
     page* directory() { return &directory_; }
 
     uint64_t size() const { return size_; }
@@ -30,17 +34,18 @@ class device_bar3 : private boost::noncopyable {
     void flush();
     void pv_reflect(context* ctx, uint32_t index, uint64_t guest, uint64_t host);
     void pv_reflect_batch(context* ctx, uint32_t index, uint64_t guest, uint64_t next, uint32_t count);
-    void map_xen_page(context* ctx, uint64_t offset);
-    void unmap_xen_page(context* ctx, uint64_t offset);
-    void map_xen_page_batch(context* ctx, uint64_t offset, uint32_t count);
-    void unmap_xen_page_batch(context* ctx, uint64_t offset, uint32_t count);
+    void release(uint32_t id);
+    void unmap_xen_pages(context* ctx);
+    void remap(context* ctx);
 
     uint64_t resolve(context* ctx, uint64_t virtual_address, struct software_page_entry* result);
 
  private:
     void reflect_internal(bool map);
+    void map_xen_pages(context* ctx, uint64_t offset, uint32_t count, a3_xen_mapping_t mapping);
     void map(uint64_t index, const struct page_entry& pdata);
 
+    ranked_mutex_t mutex_;
     uintptr_t address_;
     uint64_t size_;
     page ramin_;
@@ -49,6 +54,7 @@ class device_bar3 : private boost::noncopyable {
     std::vector<uint64_t> software_;
     std::array<software_page_entry, A3_BAR3_TOTAL_SIZE / kLARGE_PAGE_SIZE> large_;
     std::array<software_page_entry, A3_BAR3_TOTAL_SIZE / kSMALL_PAGE_SIZE> small_;
+    arena_mappings_t xen_;
 };
 
 }  // namespace a3
@@ -30,7 +30,7 @@
 namespace a3 {
 
 void direct_scheduler_t::enqueue(context* ctx, const command& cmd) {
-    A3_SYNCHRONIZED(device()->mutex()) {
+    A3_SYNCHRONIZED(device()->bar1()->mutex()) {
         device()->bar1()->write(ctx, cmd);
     }
 }
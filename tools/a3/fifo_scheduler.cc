@@ -111,7 +111,7 @@ void fifo_scheduler_t::run() {
         lock.unlock();
         utilization_.start();
 
-        A3_SYNCHRONIZED(device()->mutex()) {
+        A3_SYNCHRONIZED(device()->bar1()->mutex()) {
             device()->bar1()->write(handle.first, handle.second);
         }
 
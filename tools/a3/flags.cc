@@ -24,9 +24,18 @@
 #include <cstdint>
 #include "a3.h"
 #include "flags.h"
+#include "transport.h"
 namespace a3 {
 
 bool flags::lazy_shadowing = false;
+bool flags::bar1_remapping = false;
 bool flags::bar3_remapping = false;
+bool flags::barrier_read_only = false;
+uint32_t flags::transport = transport_t::TRANSPORT_MESSAGE_QUEUE;
+std::string flags::record;
+bool flags::simulate = false;
+uint64_t flags::shadow_cache_budget = 64ULL << 20;
+uint32_t flags::shadow_workers = 3;
+bool flags::lock_statistics = false;
 
 }  // namespace a3
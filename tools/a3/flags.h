@@ -1,11 +1,21 @@
 #ifndef A3_FLAGS_H_
 #define A3_FLAGS_H_
+#include <cstdint>
+#include <string>
 namespace a3 {
 
 class flags {
  public:
     static bool lazy_shadowing;
+    static bool bar1_remapping;
     static bool bar3_remapping;
+    static bool barrier_read_only;
+    static uint32_t transport;  // transport_t::type_t
+    static std::string record;
+    static bool simulate;
+    static uint64_t shadow_cache_budget;  // bytes
+    static uint32_t shadow_workers;
+    static bool lock_statistics;
 };
 
 }  // namespace a3
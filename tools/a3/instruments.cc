@@ -32,6 +32,7 @@ instruments_t::instruments_t(context* ctx)
     : ctx_(ctx)
     , flush_times_()
     , shadowing_times_()
+    , rescan_times_()
     , shadowing_(boost::posix_time::microseconds(0))
     , hypercalls_()
 {
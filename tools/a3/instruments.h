@@ -20,6 +20,10 @@ class instruments_t : private boost::noncopyable {
         return ++shadowing_times_;
     }
 
+    uint64_t increment_rescan_times() {
+        return ++rescan_times_;
+    }
+
     duration_t increment_shadowing(const duration_t& time) {
         shadowing_ += time;
         return shadowing_;
@@ -28,6 +32,7 @@ class instruments_t : private boost::noncopyable {
     void clear_shadowing_utilization() {
         flush_times_ = 0;
         shadowing_times_ = 0;
+        rescan_times_ = 0;
         shadowing_ = boost::posix_time::microseconds(0);
     }
 
@@ -39,6 +44,7 @@ class instruments_t : private boost::noncopyable {
     // shadowing utilization
     uint64_t flush_times_;
     uint64_t shadowing_times_;
+    uint64_t rescan_times_;  // full rescans of page tables
     duration_t shadowing_;
 
     // hypercalls
@@ -1,7 +1,14 @@
 #ifndef A3_LOCK_H_
 #define A3_LOCK_H_
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include <type_traits>
+#include <boost/noncopyable.hpp>
 #include <boost/thread.hpp>
+#include "a3.h"
 namespace a3 {
 
 typedef boost::recursive_mutex mutex_t;
@@ -9,6 +16,176 @@ typedef boost::recursive_mutex mutex_t;
 #define A3_SYNCHRONIZED(m) \
     if (auto __LOCK__ = boost::unique_lock<std::decay<decltype(m)>::type>(m))
 
+// Device wide locks, in the lock order.
+// A thread holding a lock may only acquire locks listed below it.
+// Re-acquiring the held lock is allowed since they are recursive.
+// The order is checked in the debug build.
+//
+//   DEVICE     contexts, virtual GPU ids, playlist
+//   BAR1       device_bar1 shadow page table, poll area and Xen mappings
+//   BAR3       device_bar3 shadow page table and Xen mappings
+//   PMEM       PRAMIN window (0x1700) and accesses through it
+//   REGISTERS  BAR0 register sequences
+//   VRAM       vram_manager_t free list
+//   P2M        p2m_cache_t extents
+//   XEN        libxl / libxc calls
+#define A3_LOCK_RANKS(V)\
+    V(DEVICE, device)\
+    V(BAR1, bar1)\
+    V(BAR3, bar3)\
+    V(PMEM, pmem)\
+    V(REGISTERS, registers)\
+    V(VRAM, vram)\
+    V(P2M, p2m)\
+    V(XEN, xen)
+
+enum lock_rank_t {
+#define V(NAME, name) LOCK_RANK_##NAME,
+    A3_LOCK_RANKS(V)
+#undef V
+    LOCK_RANKS
+};
+
+inline const char* lock_rank_name(lock_rank_t rank) {
+    static const char* names[] = {
+#define V(NAME, name) #name,
+        A3_LOCK_RANKS(V)
+#undef V
+    };
+    return names[rank];
+}
+
+// contended is always counted. the others are counted with --lock-statistics,
+// since they put a clock read and atomics on every acquisition
+struct lock_statistics_t {
+    std::atomic<uint64_t> acquired;
+    std::atomic<uint64_t> contended;
+    std::atomic<uint64_t> held;      // ns
+    std::atomic<uint64_t> max_held;  // ns
+};
+
+inline lock_statistics_t* lock_statistics(lock_rank_t rank) {
+    static lock_statistics_t statistics[LOCK_RANKS];
+    return &statistics[rank];
+}
+
+class ranked_mutex_t : private boost::noncopyable {
+ public:
+    typedef boost::unique_lock<ranked_mutex_t> scoped_lock;
+
+    explicit ranked_mutex_t(lock_rank_t rank)
+        : rank_(rank)
+        , mutex_()
+        , depth_(0)
+        , start_()
+        , owner_()
+    {
+    }
+
+    lock_rank_t rank() const { return rank_; }
+
+    // whether the current thread holds this lock
+    bool owned() const {
+        return owner_.load(std::memory_order_relaxed) == std::this_thread::get_id();
+    }
+
+    void lock() {
+        check_order();
+        if (!mutex_.try_lock()) {
+            lock_statistics(rank_)->contended.fetch_add(1, std::memory_order_relaxed);
+            mutex_.lock();
+        }
+        acquired();
+    }
+
+    bool try_lock() {
+        check_order();
+        if (!mutex_.try_lock()) {
+            return false;
+        }
+        acquired();
+        return true;
+    }
+
+    void unlock() {
+        if (--depth_ == 0) {
+            owner_.store(std::thread::id(), std::memory_order_relaxed);
+            if (flags::lock_statistics) {
+                record_held();
+            }
+        }
+#if !defined(NDEBUG)
+        held_locks_t* held = held_locks();
+        for (int i = held->size - 1; i >= 0; --i) {
+            if (held->locks[i] == this) {
+                std::copy(held->locks + i + 1, held->locks + held->size, held->locks + i);
+                --held->size;
+                break;
+            }
+        }
+#endif
+        mutex_.unlock();
+    }
+
+ private:
+    typedef std::chrono::steady_clock clock_type;
+
+    void acquired() {
+        if (depth_++ == 0) {
+            owner_.store(std::this_thread::get_id(), std::memory_order_relaxed);
+            if (flags::lock_statistics) {
+                start_ = clock_type::now();
+                lock_statistics(rank_)->acquired.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+#if !defined(NDEBUG)
+        held_locks_t* held = held_locks();
+        ASSERT(held->size < kMAX_HELD);
+        held->locks[held->size++] = this;
+#endif
+    }
+
+    void record_held() {
+        const uint64_t held = std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start_).count();
+        lock_statistics_t* statistics = lock_statistics(rank_);
+        statistics->held.fetch_add(held, std::memory_order_relaxed);
+        uint64_t max = statistics->max_held.load(std::memory_order_relaxed);
+        while (held > max && !statistics->max_held.compare_exchange_weak(max, held, std::memory_order_relaxed));
+    }
+
+    void check_order() const {
+#if !defined(NDEBUG)
+        const held_locks_t* held = held_locks();
+        for (int i = 0; i < held->size; ++i) {
+            if (held->locks[i] != this && held->locks[i]->rank_ >= rank_) {
+                A3_FATAL(stderr, "lock order violation: %s while holding %s\n", lock_rank_name(rank_), lock_rank_name(held->locks[i]->rank_));
+                ASSERT(false);
+            }
+        }
+#endif
+    }
+
+    lock_rank_t rank_;
+    boost::recursive_mutex mutex_;
+    int depth_;  // guarded by mutex_
+    clock_type::time_point start_;
+    std::atomic<std::thread::id> owner_;
+
+#if !defined(NDEBUG)
+    // ranked locks held by the current thread
+    static const int kMAX_HELD = 32;
+    struct held_locks_t {
+        int size;
+        const ranked_mutex_t* locks[kMAX_HELD];
+    };
+
+    static held_locks_t* held_locks() {
+        static __thread held_locks_t held;
+        return &held;
+    }
+#endif
+};
+
 }  // namespace a3
 #endif  // A3_LOCK_H_
 /* vim: set sw=4 ts=4 et tw=80 : */
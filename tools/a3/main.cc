@@ -30,6 +30,8 @@
 #include "context.h"
 #include "device.h"
 #include "cmdline.h"
+#include "transport.h"
+#include "trace.h"
 namespace a3 {
 
 class server {
@@ -76,7 +78,18 @@ int main(int argc, char** argv) {
     cmd.Add("version", "version", 'v', "print the version");
     cmd.Add("through", "through", 't', "through I/O");
     cmd.Add("lazy-shadowing", "lazy-shadowing", 0, "Enable lazy shadowing");
+    cmd.Add("bar1-remapping", "bar1-remapping", 0, "Enable BAR1 remapping");
     cmd.Add("bar3-remapping", "bar3-remapping", 0, "Enable BAR3 remapping");
+    cmd.Add("barrier-read-only", "barrier-read-only", 0, "Map remapped barrier pages read-only and trap only writes");
+    cmd.Add("simulate", "simulate", 0, "Run on the simulated NVC0 instead of the device");
+    cmd.Add<std::string>("trace", "trace", 0, "Write binary trace to the file", false, "");
+    cmd.Add<std::string>("trace-categories", "trace-categories", 0, "Trace categories (command,barrier,shadow,scheduler,all)", false, "command");
+    cmd.Add<int>("trace-level", "trace-level", 0, "Trace level (0: off, 1: info, 2: debug)", false, 1);
+    cmd.Add<std::string>("record", "record", 0, "Record command streams into the directory", false, "");
+    cmd.Add<int>("shadow-cache", "shadow-cache", 0, "VRAM budget of shadow page tables per context (MB)", false, 64);
+    cmd.Add<int>("shadow-workers", "shadow-workers", 0, "Worker threads refreshing shadow page tables (0: sequential)", false, 3);
+    cmd.Add<std::string>("transport", "transport", 0, "MMIO command transport (mq|ring)", false, "mq");
+    cmd.Add("lock-statistics", "lock-statistics", 0, "Count lock acquisitions and hold times");
     cmd.set_footer("[program_file] [arguments]");
 
     if (!cmd.Parse(argc, argv)) {
@@ -98,17 +111,51 @@ int main(int argc, char** argv) {
 
     c::bdf bdf = { { { 0, 0, 0 } } };
 
-    if (rest.empty() || ((bdf.raw = strtol(rest.front().c_str(), nullptr, 16)) == 0)) {
+    if (!cmd.Exist("simulate") && (rest.empty() || ((bdf.raw = strtol(rest.front().c_str(), nullptr, 16)) == 0))) {
         A3_FPRINTF(stderr, "Usage: a3 bdf\n");
         return 1;
     }
 
     A3_LOG("BDF: %02x:%02x.%01x\n", bdf.bus, bdf.dev, bdf.func);
+    A3_LOG("simulate: %s\n", cmd.Exist("simulate") ? "enabled" : "disabled");
     A3_LOG("through: %s\n", cmd.Exist("through") ? "enabled" : "disabled");
 
     // set flags
     a3::flags::lazy_shadowing = cmd.Exist("lazy-shadowing");
+    a3::flags::bar1_remapping = cmd.Exist("bar1-remapping");
     a3::flags::bar3_remapping = cmd.Exist("bar3-remapping");
+    a3::flags::barrier_read_only = cmd.Exist("barrier-read-only");
+    a3::flags::record = cmd.Get<std::string>("record");
+    a3::flags::simulate = cmd.Exist("simulate");
+    if (cmd.Get<int>("shadow-cache") < 0) {
+        A3_FPRINTF(stderr, "Invalid shadow cache budget: %d\n", cmd.Get<int>("shadow-cache"));
+        return 1;
+    }
+    a3::flags::shadow_cache_budget = static_cast<uint64_t>(cmd.Get<int>("shadow-cache")) << 20;
+    a3::flags::shadow_workers = cmd.Get<int>("shadow-workers");
+    a3::flags::lock_statistics = cmd.Exist("lock-statistics");
+    {
+        const std::string transport = cmd.Get<std::string>("transport");
+        if (transport == "ring") {
+            a3::flags::transport = a3::transport_t::TRANSPORT_RING;
+        } else if (transport == "mq") {
+            a3::flags::transport = a3::transport_t::TRANSPORT_MESSAGE_QUEUE;
+        } else {
+            A3_FPRINTF(stderr, "Unknown transport: %s\n", transport.c_str());
+            return 1;
+        }
+        A3_LOG("transport: %s\n", transport.c_str());
+    }
+
+    if (!cmd.Get<std::string>("trace").empty()) {
+        if (!a3::trace::open(cmd.Get<std::string>("trace"))) {
+            A3_FPRINTF(stderr, "Cannot open trace file: %s\n", cmd.Get<std::string>("trace").c_str());
+            return 1;
+        }
+        a3::trace::configure(
+            a3::trace::parse_categories(cmd.Get<std::string>("trace-categories")),
+            static_cast<a3::trace::level_t>(cmd.Get<int>("trace-level")));
+    }
 
     c::device()->initialize(bdf);
 
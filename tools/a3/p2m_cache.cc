@@ -0,0 +1,171 @@
+/*
+ * A3 P2M Cache
+ *
+ * Copyright (c) 2012-2013 Yusuke Suzuki
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <array>
+#include <cinttypes>
+#include "a3.h"
+#include "device.h"
+#include "xen.h"
+#include "p2m_cache.h"
+namespace a3 {
+
+p2m_cache_t::p2m_cache_t(int domid)
+    : domid_(domid)
+    , mutex_(LOCK_RANK_P2M)
+    , extents_()
+    , generation_(generation().load())
+    , p2m_generation_(0)
+    , p2m_generation_known_(false)
+{
+}
+
+std::atomic<uint64_t>& p2m_cache_t::generation() {
+    static std::atomic<uint64_t> generation(0);
+    return generation;
+}
+
+void p2m_cache_t::synchronize() {
+    A3_SYNCHRONIZED(mutex_) {
+        uint64_t p2m_generation = 0;
+        int ret = 0;
+        A3_SYNCHRONIZED(device()->xen_mutex()) {
+            ret = a3_xen_p2m_generation(device()->xl_ctx(), domid_, &p2m_generation);
+        }
+        if (ret != 0 || !p2m_generation_known_ || p2m_generation != p2m_generation_) {
+            extents_.clear();
+        }
+        p2m_generation_ = p2m_generation;
+        p2m_generation_known_ = ret == 0;
+    }
+}
+
+void p2m_cache_t::bump() {
+    generation().fetch_add(1);
+}
+
+uint64_t p2m_cache_t::lookup(uint64_t gfn) {
+    A3_SYNCHRONIZED(mutex_) {
+        revalidate();
+        uint64_t mfn = 0;
+        if (!find(gfn, &mfn)) {
+            fill(gfn);
+            find(gfn, &mfn);
+        }
+        return mfn;
+    }
+    return 0;  // make compiler happy
+}
+
+void p2m_cache_t::prefetch(const std::vector<uint64_t>& gfns) {
+    A3_SYNCHRONIZED(mutex_) {
+        revalidate();
+        std::vector<unsigned long> missing;
+        for (uint64_t gfn : gfns) {
+            uint64_t mfn;
+            if (!find(gfn, &mfn)) {
+                missing.push_back(gfn);
+            }
+        }
+        if (missing.empty()) {
+            return;
+        }
+        std::vector<unsigned long> mfns(missing.size());
+        A3_SYNCHRONIZED(device()->xen_mutex()) {
+            a3_xen_gfn_to_mfn_batch(device()->xl_ctx(), domid_, missing.data(), missing.size(), mfns.data());
+        }
+        for (std::size_t i = 0; i < missing.size(); ++i) {
+            if (mfns[i]) {
+                insert(missing[i], mfns[i]);
+            }
+        }
+        A3_LOG("p2m prefetch %" PRIu64 " gfns of domain %d\n", static_cast<uint64_t>(missing.size()), domid_);
+    }
+}
+
+// drops extents of the old generation
+void p2m_cache_t::revalidate() {
+    const uint64_t generation = p2m_cache_t::generation().load();
+    if (generation_ != generation || extents_.size() > kMAX_EXTENTS) {
+        extents_.clear();
+        generation_ = generation;
+    }
+}
+
+bool p2m_cache_t::find(uint64_t gfn, uint64_t* mfn) const {
+    extents_t::const_iterator it = extents_.upper_bound(gfn);
+    if (it == extents_.begin()) {
+        return false;
+    }
+    --it;
+    if (gfn >= it->first + it->second.count) {
+        return false;
+    }
+    *mfn = it->second.mfn + (gfn - it->first);
+    return true;
+}
+
+void p2m_cache_t::fill(uint64_t gfn) {
+    const uint64_t first = gfn - (gfn % kFILL_GFNS);
+    std::array<unsigned long, kFILL_GFNS> mfns;
+    A3_SYNCHRONIZED(device()->xen_mutex()) {
+        a3_xen_gfn_to_mfn_range(device()->xl_ctx(), domid_, first, kFILL_GFNS, mfns.data());
+    }
+    for (uint64_t i = 0; i < kFILL_GFNS; ++i) {
+        if (mfns[i]) {
+            insert(first + i, mfns[i]);
+        }
+    }
+    A3_LOG("p2m fill 0x%" PRIx64 " of domain %d\n", first, domid_);
+}
+
+// merges with the adjacent extents if contiguous
+void p2m_cache_t::insert(uint64_t gfn, uint64_t mfn) {
+    uint64_t dummy;
+    if (find(gfn, &dummy)) {
+        return;
+    }
+    extents_t::iterator next = extents_.upper_bound(gfn);
+    if (next != extents_.begin()) {
+        extents_t::iterator prev = next;
+        --prev;
+        if (prev->first + prev->second.count == gfn && prev->second.mfn + prev->second.count == mfn) {
+            ++prev->second.count;
+            if (next != extents_.end() && next->first == gfn + 1 && next->second.mfn == mfn + 1) {
+                prev->second.count += next->second.count;
+                extents_.erase(next);
+            }
+            return;
+        }
+    }
+    if (next != extents_.end() && next->first == gfn + 1 && next->second.mfn == mfn + 1) {
+        const extent_t extent = { next->second.count + 1, mfn };
+        extents_.erase(next);
+        extents_.insert(std::make_pair(gfn, extent));
+        return;
+    }
+    const extent_t extent = { 1, mfn };
+    extents_.insert(std::make_pair(gfn, extent));
+}
+
+}  // namespace a3
+/* vim: set sw=4 ts=4 et tw=80 : */
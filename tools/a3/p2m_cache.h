@@ -0,0 +1,57 @@
+#ifndef A3_P2M_CACHE_H_
+#define A3_P2M_CACHE_H_
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include "lock.h"
+namespace a3 {
+
+// gfn => mfn cache of a domain, shared by every guest_to_host caller.
+// Contiguous translations are kept as extents. A miss fills the aligned
+// block of kFILL_GFNS gfns around it at once. The cache is dropped when the
+// global generation is bumped (a domain is initialized or a3-client asks for
+// it), or when it grows over kMAX_EXTENTS. Users call synchronize() before
+// each batch of translations (TLB flush, page table refresh, PV map), which
+// drops it when the hypervisor side p2m generation of the domain moved, or
+// every time on hypervisors which do not report it.
+class p2m_cache_t : private boost::noncopyable {
+ public:
+    static const uint64_t kFILL_GFNS = 32;  // 128KB, a large page
+    static const std::size_t kMAX_EXTENTS = 0x10000;
+
+    explicit p2m_cache_t(int domid);
+    // returns 0 if gfn is not mapped
+    uint64_t lookup(uint64_t gfn);
+    // translates the missing ones of gfns with batched hypercalls
+    void prefetch(const std::vector<uint64_t>& gfns);
+    // drops the cache if the p2m of the domain changed since the last call
+    void synchronize();
+    // invalidates caches of all domains
+    static void bump();
+
+ private:
+    struct extent_t {
+        uint64_t count;
+        uint64_t mfn;
+    };
+    typedef std::map<uint64_t, extent_t> extents_t;  // first gfn => extent
+
+    void revalidate();
+    bool find(uint64_t gfn, uint64_t* mfn) const;
+    void fill(uint64_t gfn);
+    void insert(uint64_t gfn, uint64_t mfn);
+    static std::atomic<uint64_t>& generation();
+
+    int domid_;
+    ranked_mutex_t mutex_;
+    extents_t extents_;
+    uint64_t generation_;
+    uint64_t p2m_generation_;
+    bool p2m_generation_known_;
+};
+
+}  // namespace a3
+#endif  // A3_P2M_CACHE_H_
+/* vim: set sw=4 ts=4 et tw=80 : */
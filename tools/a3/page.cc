@@ -21,52 +21,93 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
  */
+#include <atomic>
 #include <cstdio>
+#include <cstring>
 #include "a3.h"
 #include "page.h"
 #include "pmem.h"
+#include "mmio.h"
 namespace a3 {
 
 page::page(std::size_t n)
-    : vram_() {
-    A3_SYNCHRONIZED(device()->mutex()) {
-        vram_ = device()->malloc(n);
-    }
+    : vram_()
+    , aperture_() {
+    // vram_manager_t has its own lock
+    vram_ = device()->malloc(n);
+    aperture_ = device()->aperture(address(), size());
 }
 
 page::~page() {
-    A3_SYNCHRONIZED(device()->mutex()) {
-        device()->free(vram_);
-    }
+    device()->free(vram_);
 }
 
 void page::clear() {
+    if (aperture_) {
+        std::memset(aperture_, 0, size());
+        return;
+    }
     pmem::accessor pmem;
-    for (std::size_t i = 0; i < (size() / sizeof(uint32_t)); i += sizeof(uint32_t)) {
+    for (std::size_t i = 0; i < size(); i += sizeof(uint32_t)) {
         pmem.write32(address() + i, 0);
     }
 }
 
 void page::write32(uint64_t offset, uint32_t value) {
     ASSERT(offset < size());
+    if (aperture_) {
+        mmio::write32(aperture_, offset, value);
+        return;
+    }
     pmem::write32(address() + offset, value);
 }
 
 uint32_t page::read32(uint64_t offset) {
     ASSERT(offset < size());
+    if (aperture_) {
+        return mmio::read32(aperture_, offset);
+    }
     return pmem::read32(address() + offset);
 }
 
 void page::write(uint64_t offset, uint32_t value, std::size_t s) {
     ASSERT(offset < size());
-    pmem::accessor pmem;
-    pmem.write(address() + offset, value, s);
+    device()->write_pmem(address() + offset, value, s);
 }
 
 uint32_t page::read(uint64_t offset, std::size_t s) {
     ASSERT(offset < size());
+    return device()->read_pmem(address() + offset, s);
+}
+
+void page::write_block(uint64_t offset, const void* data, std::size_t s) {
+    ASSERT(offset + s <= size());
+    ASSERT((s % sizeof(uint32_t)) == 0);
+    if (aperture_) {
+        std::memcpy(aperture_ + offset, data, s);
+        // the block is usually published by a following table write
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return;
+    }
+    const uint32_t* words = static_cast<const uint32_t*>(data);
     pmem::accessor pmem;
-    return pmem.read(address() + offset, s);
+    for (std::size_t i = 0; i < s; i += sizeof(uint32_t)) {
+        pmem.write32(address() + offset + i, words[i / sizeof(uint32_t)]);
+    }
+}
+
+void page::read_block(uint64_t offset, void* data, std::size_t s) {
+    ASSERT(offset + s <= size());
+    ASSERT((s % sizeof(uint32_t)) == 0);
+    if (aperture_) {
+        std::memcpy(data, aperture_ + offset, s);
+        return;
+    }
+    uint32_t* words = static_cast<uint32_t*>(data);
+    pmem::accessor pmem;
+    for (std::size_t i = 0; i < s; i += sizeof(uint32_t)) {
+        words[i / sizeof(uint32_t)] = pmem.read32(address() + offset + i);
+    }
 }
 
 std::size_t page::page_size() const {
@@ -15,11 +15,14 @@ class page : private boost::noncopyable {
     uint32_t read32(uint64_t offset);
     void write(uint64_t offset, uint32_t value, std::size_t s);
     uint32_t read(uint64_t offset, std::size_t s);
+    void write_block(uint64_t offset, const void* data, std::size_t s);
+    void read_block(uint64_t offset, void* data, std::size_t s);
     std::size_t page_size() const;
     uint64_t size() const;
 
  private:
     vram_t* vram_;
+    uint8_t* aperture_;  // nullptr if not covered by the BAR1 aperture
 };
 
 }  // namespace a3
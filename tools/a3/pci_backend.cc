@@ -0,0 +1,159 @@
+/*
+ * A3 PCI device backend
+ *
+ * Copyright (c) 2012-2013 Yusuke Suzuki
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <cinttypes>
+#include <pciaccess.h>
+#include "a3.h"
+#include "pci_backend.h"
+#include "mmio.h"
+#include "ignore_unused_variable_warning.h"
+#include "assertion.h"
+
+#define NVC0_VENDOR 0x10DE
+#define NVC0_DEVICE 0x6D8
+#define NVC0_COMMAND 0x07
+#define NVC0_REVISION 0xA3
+#define PCI_COMMAND 0x04
+
+namespace a3 {
+
+pci_backend_t::pci_backend_t()
+    : device_()
+    , bars_()
+{
+}
+
+pci_backend_t::~pci_backend_t() {
+    if (device_) {
+        pci_system_cleanup();
+    }
+}
+
+// not thread safe
+bool pci_backend_t::initialize(const bdf& bdf) {
+    struct pci_id_match nvc0_match = {
+        NVC0_VENDOR,
+        PCI_MATCH_ANY,
+        PCI_MATCH_ANY,
+        PCI_MATCH_ANY,
+        0x30000,
+        0xFFFF0000,
+        0
+    };
+    int ret;
+
+    ret = pci_system_init();
+    ASSERT(!ret);
+    ignore_unused_variable_warning(ret);
+
+    struct pci_device_iterator* it = pci_id_match_iterator_create(&nvc0_match);
+    ASSERT(it);
+
+    struct pci_device* dev;
+    while ((dev = pci_device_next(it)) != nullptr) {
+        // search by BDF
+        if (dev->bus == bdf.bus && dev->dev == bdf.dev && dev->func == bdf.func) {
+            break;
+        }
+    }
+    pci_iterator_destroy(it);
+
+    ASSERT(dev);
+    pci_device_enable(dev);
+    ret = pci_device_probe(dev);
+    ASSERT(!ret);
+
+    // And enable memory and io port.
+    // FIXME(Yusuke Suzuki)
+    // This is very ad-hoc code.
+    // We should cleanup and set precise command code in the future.
+    pci_device_cfg_write_u16(dev, NVC0_COMMAND, PCI_COMMAND);
+    device_ = dev;
+
+    // init BARs
+    void* addr;
+    ret = pci_device_map_range(dev, dev->regions[0].base_addr, dev->regions[0].size, PCI_DEV_MAP_FLAG_WRITABLE, &addr);
+    bars_[0].addr = addr;
+    bars_[0].base_addr = dev->regions[0].base_addr;
+    bars_[0].size = dev->regions[0].size;
+    ret = pci_device_map_range(dev, dev->regions[1].base_addr, dev->regions[1].size, PCI_DEV_MAP_FLAG_WRITABLE, &addr);
+    bars_[1].addr = addr;
+    bars_[1].base_addr = dev->regions[1].base_addr;
+    bars_[1].size = dev->regions[1].size;
+    ret = pci_device_map_range(dev, dev->regions[3].base_addr, dev->regions[3].size, PCI_DEV_MAP_FLAG_WRITABLE, &addr);
+    bars_[3].addr = addr;
+    bars_[3].base_addr = dev->regions[3].base_addr;
+    bars_[3].size = dev->regions[3].size;
+
+    if (!device_) {
+        pci_system_cleanup();
+        return false;
+    }
+    return true;
+}
+
+uint32_t pci_backend_t::read(int bar, uint32_t offset, std::size_t size) {
+    switch (size) {
+    case sizeof(uint8_t):
+        return mmio::read8(bars_[bar].addr, offset);
+    case sizeof(uint16_t):
+        return mmio::read16(bars_[bar].addr, offset);
+    case sizeof(uint32_t):
+        return mmio::read32(bars_[bar].addr, offset);
+    }
+    A3_LOG("%" PRIu64 " is invalid\n", size);
+    A3_UNREACHABLE();
+    return 0;
+}
+
+void pci_backend_t::write(int bar, uint32_t offset, uint32_t val, std::size_t size) {
+    switch (size) {
+    case sizeof(uint8_t):
+        mmio::write8(bars_[bar].addr, offset, val);
+        return;
+    case sizeof(uint16_t):
+        mmio::write16(bars_[bar].addr, offset, val);
+        return;
+    case sizeof(uint32_t):
+        mmio::write32(bars_[bar].addr, offset, val);
+        return;
+    }
+    A3_LOG("%" PRIu64 " is invalid\n", size);
+    A3_UNREACHABLE();
+    return;
+}
+
+void* pci_backend_t::map_aperture(uint64_t offset, uint64_t vram, std::size_t size) {
+    if ((offset + size) > bars_[1].size) {
+        return nullptr;
+    }
+    // write combined, released by pci_system_cleanup
+    void* addr;
+    if (pci_device_map_range(device_, bars_[1].base_addr + offset, size, PCI_DEV_MAP_FLAG_WRITABLE | PCI_DEV_MAP_FLAG_WRITE_COMBINE, &addr)) {
+        return nullptr;
+    }
+    return addr;
+}
+
+}  // namespace a3
+/* vim: set sw=4 ts=4 et tw=80 : */
@@ -0,0 +1,26 @@
+#ifndef A3_PCI_BACKEND_H_
+#define A3_PCI_BACKEND_H_
+#include <array>
+#include <pciaccess.h>
+#include "device_backend.h"
+namespace a3 {
+
+class pci_backend_t : public device_backend_t {
+ public:
+    pci_backend_t();
+    virtual ~pci_backend_t();
+    virtual bool simulated() const { return false; }
+    virtual bool initialize(const bdf& bdf);
+    virtual const device_bar_t& bar(int index) const { return bars_[index]; }
+    virtual uint32_t read(int bar, uint32_t offset, std::size_t size);
+    virtual void write(int bar, uint32_t offset, uint32_t val, std::size_t size);
+    virtual void* map_aperture(uint64_t offset, uint64_t vram, std::size_t size);
+
+ private:
+    struct pci_device* device_;
+    std::array<device_bar_t, 5> bars_;
+};
+
+}  // namespace a3
+#endif  // A3_PCI_BACKEND_H_
+/* vim: set sw=4 ts=4 et tw=80 : */
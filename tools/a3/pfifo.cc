@@ -29,15 +29,19 @@
 #include "bit_mask.h"
 namespace a3 {
 
+const uint32_t pfifo_t::kNVC0_RANGE;
+const uint32_t pfifo_t::kNVE0_RANGE;
+const uint32_t pfifo_t::kCHANNEL_SIZE;
+
 pfifo_t::pfifo_t()
     : total_channels_(A3_CHANNELS)
     , channels_(A3_DOMAIN_CHANNELS)
-    , range_(device()->chipset()->type() == card::NVC0 ? 0x003000 : 0x800000)
+    , range_(device()->chipset()->type() == card::NVC0 ? kNVC0_RANGE : kNVE0_RANGE)
 {
 }
 
 bool pfifo_t::in_range(uint32_t offset) const {
-    return offset >= range() && (offset - range()) <= total_channels() * 8;
+    return offset >= range() && (offset - range()) <= total_channels() * kCHANNEL_SIZE;
 }
 
 void pfifo_t::write(context* ctx, command cmd) {
@@ -68,6 +72,12 @@ void pfifo_t::write(context* ctx, command cmd) {
         // channel ramin
         // VRAM shift
         ctx->reg32(cmd.offset) = cmd.value;
+        if (!(cmd.value & 0x80000000)) {
+            // unbound by the guest (channel fini)
+            ctx->channels(virt_channel_id)->disable(ctx);
+            registers::write32(adjusted_offset, cmd.value);
+            return;
+        }
         const uint64_t virt = (bit_mask<28, uint64_t>(cmd.value) << 12);
         const uint64_t phys = ctx->get_phys_address(virt);
         const uint64_t shadow = ctx->channels(virt_channel_id)->refresh(ctx, phys);
@@ -9,6 +9,11 @@ class context;
 
 class pfifo_t {
  public:
+    // channel table base, each channel has 8 bytes (RAMIN and status)
+    static const uint32_t kNVC0_RANGE = 0x003000;
+    static const uint32_t kNVE0_RANGE = 0x800000;
+    static const uint32_t kCHANNEL_SIZE = 0x8;
+
     pfifo_t();
     inline uint32_t channels() const { return channels_; }
     bool in_range(uint32_t offset) const;
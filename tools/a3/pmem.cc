@@ -21,6 +21,7 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
  */
+#include <algorithm>
 #include "pmem.h"
 #include "device.h"
 #include "bit_mask.h"
@@ -35,5 +36,40 @@ void accessor::write(uint64_t addr, uint32_t val, std::size_t size) {
     device()->write_pmem(addr, val, size);
 }
 
+// indices of the batch, grouped by the window
+static void group(const batch_t& batch, std::vector<std::size_t>* order) {
+    order->resize(batch.size());
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+        (*order)[i] = i;
+    }
+    std::stable_sort(order->begin(), order->end(), [&batch](std::size_t lhs, std::size_t rhs) {
+        return window(batch[lhs].addr) < window(batch[rhs].addr);
+    });
+    statistics()->batched.fetch_add(batch.size(), std::memory_order_relaxed);
+}
+
+void accessor::read32(batch_t* batch) {
+    std::vector<std::size_t> order;
+    group(*batch, &order);
+    for (std::size_t index : order) {
+        operation_t& op = (*batch)[index];
+        op.value = read32(op.addr);
+    }
+}
+
+void accessor::write32(const batch_t& batch) {
+    std::vector<std::size_t> order;
+    group(batch, &order);
+    for (std::size_t index : order) {
+        const operation_t& op = batch[index];
+        write32(op.addr, op.value);
+    }
+}
+
+statistics_t* statistics() {
+    static statistics_t statistics;
+    return &statistics;
+}
+
 } }  // namespace a3::pmem
 /* vim: set sw=4 ts=4 et tw=80 : */
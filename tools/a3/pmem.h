@@ -1,14 +1,37 @@
 #ifndef A3_pmem_H_
 #define A3_pmem_H_
+#include <atomic>
+#include <vector>
 #include <boost/noncopyable.hpp>
 #include "device.h"
 namespace a3 {
 namespace pmem {
 
+// PRAMIN window (0x1700 value) that covers addr
+inline uint32_t window(uint64_t addr) {
+    return (addr & 0xffffff00000ULL) >> 16;
+}
+
+struct statistics_t {
+    std::atomic<uint64_t> accesses;  // through the PRAMIN window
+    std::atomic<uint64_t> switches;  // 0x1700 rewrites
+    std::atomic<uint64_t> batched;   // accesses issued by batches
+};
+
+statistics_t* statistics();
+
+// 32bit access of a batch
+struct operation_t {
+    uint64_t addr;
+    uint32_t value;
+};
+
+typedef std::vector<operation_t> batch_t;
+
 class accessor : private boost::noncopyable {
  public:
     accessor()
-        : lock_(a3::device()->mutex())
+        : lock_(a3::device()->pmem_mutex())
     {
     }
 
@@ -39,10 +62,26 @@ class accessor : private boost::noncopyable {
         write(addr, val, sizeof(uint8_t));
     }
 
+    // Batched 32bit accesses. Operations are issued grouped by the PRAMIN
+    // window, so the window is switched once per window instead of per
+    // access. Operations on the same address keep their order.
+    void read32(batch_t* batch);
+    void write32(const batch_t& batch);
+
  private:
-    mutex_t::scoped_lock lock_;
+    ranked_mutex_t::scoped_lock lock_;
 };
 
+inline uint32_t read(uint64_t addr, std::size_t size) {
+    accessor pmem;
+    return pmem.read(addr, size);
+}
+
+inline void write(uint64_t addr, uint32_t val, std::size_t size) {
+    accessor pmem;
+    pmem.write(addr, val, size);
+}
+
 inline uint32_t read32(uint64_t addr) {
     accessor pmem;
     return pmem.read32(addr);
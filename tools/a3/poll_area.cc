@@ -48,13 +48,13 @@ poll_area_t::channel_and_offset_t poll_area_t::extract_channel_and_offset(contex
 }
 
 void poll_area_t::write(context* ctx, const command& cmd) {
-    A3_SYNCHRONIZED(device()->mutex()) {
+    A3_SYNCHRONIZED(device()->bar1()->mutex()) {
         device()->bar1()->write(ctx, cmd);
     }
 }
 
 uint32_t poll_area_t::read(context* ctx, const command& cmd) {
-    A3_SYNCHRONIZED(device()->mutex()) {
+    A3_SYNCHRONIZED(device()->bar1()->mutex()) {
         return device()->bar1()->read(ctx, cmd);
     }
     return 0;
@@ -0,0 +1,97 @@
+/*
+ * A3 command stream recorder
+ *
+ * Copyright (c) 2012-2013 Yusuke Suzuki
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <cstdio>
+#include "a3.h"
+#include "recorder.h"
+namespace a3 {
+
+recorder_t::recorder_t(const std::string& path)
+    : mutex_()
+    , file_(std::fopen(path.c_str(), "wb"))
+{
+    if (!file_) {
+        A3_FATAL(stderr, "cannot open record file %s\n", path.c_str());
+        return;
+    }
+    const record_file_header_t header = {
+        record_file_header_t::kMAGIC,
+        record_file_header_t::kVERSION,
+        sizeof(command)
+    };
+    std::fwrite(&header, sizeof(header), 1, file_);
+}
+
+recorder_t::~recorder_t() {
+    if (file_) {
+        std::fclose(file_);
+    }
+}
+
+void recorder_t::record(uint64_t timestamp, const command& cmd, const void* payload, uint32_t size) {
+    if (!file_) {
+        return;
+    }
+    const record_t record = { timestamp, size, 0, cmd };
+    boost::mutex::scoped_lock lock(mutex_);
+    std::fwrite(&record, sizeof(record), 1, file_);
+    if (size) {
+        std::fwrite(payload, size, 1, file_);
+    }
+}
+
+record_reader_t::record_reader_t(const std::string& path)
+    : file_(std::fopen(path.c_str(), "rb"))
+{
+    if (!file_) {
+        return;
+    }
+    record_file_header_t header;
+    if (std::fread(&header, sizeof(header), 1, file_) != 1 ||
+        header.magic != record_file_header_t::kMAGIC ||
+        header.version != record_file_header_t::kVERSION ||
+        header.command_size != sizeof(command)) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+record_reader_t::~record_reader_t() {
+    if (file_) {
+        std::fclose(file_);
+    }
+}
+
+bool record_reader_t::next(record_t* record, std::vector<uint8_t>* payload) {
+    if (std::fread(record, sizeof(record_t), 1, file_) != 1) {
+        return false;
+    }
+    payload->resize(record->payload);
+    if (record->payload && std::fread(payload->data(), record->payload, 1, file_) != 1) {
+        return false;
+    }
+    return true;
+}
+
+}  // namespace a3
+/* vim: set sw=4 ts=4 et tw=80 : */
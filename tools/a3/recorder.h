@@ -0,0 +1,56 @@
+#ifndef A3_RECORDER_H_
+#define A3_RECORDER_H_
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+#include "a3.h"
+namespace a3 {
+
+// Command stream file. Each record has the arrival timestamp and the command.
+// TYPE_BATCH carries its entries as the payload following the record, since
+// they live in shared memory.
+struct record_file_header_t {
+    static const uint32_t kMAGIC = 0x43523341;  // "A3RC"
+    static const uint32_t kVERSION = 1;
+    uint32_t magic;
+    uint32_t version;
+    uint32_t command_size;
+    uint32_t reserved;
+};
+
+struct record_t {
+    uint64_t timestamp;  // ns
+    uint32_t payload;    // bytes
+    uint32_t reserved;
+    command cmd;
+};
+
+class recorder_t : private boost::noncopyable {
+ public:
+    explicit recorder_t(const std::string& path);
+    ~recorder_t();
+    bool is_open() const { return file_ != nullptr; }
+    void record(uint64_t timestamp, const command& cmd, const void* payload = nullptr, uint32_t size = 0);
+
+ private:
+    boost::mutex mutex_;
+    std::FILE* file_;
+};
+
+class record_reader_t : private boost::noncopyable {
+ public:
+    explicit record_reader_t(const std::string& path);
+    ~record_reader_t();
+    bool is_open() const { return file_ != nullptr; }
+    bool next(record_t* record, std::vector<uint8_t>* payload);
+
+ private:
+    std::FILE* file_;
+};
+
+}  // namespace a3
+#endif  // A3_RECORDER_H_
+/* vim: set sw=4 ts=4 et tw=80 : */
@@ -0,0 +1,76 @@
+#ifndef A3_REGISTER_FILE_H_
+#define A3_REGISTER_FILE_H_
+#include <cstdint>
+#include <array>
+#include <boost/noncopyable.hpp>
+#include "a3.h"
+namespace a3 {
+
+// Virtualized BAR0 registers of the context.
+// Only the offsets in the register map and the PFIFO channel range are stored,
+// so instead of the dense BAR0 sized array, they are kept in the small open
+// addressing table. Entries are never removed and the table is never rehashed,
+// so the reference returned by operator[] stays valid.
+class register_file_t : private boost::noncopyable {
+ public:
+    static const std::size_t kCAPACITY = 1024;
+    static const uint32_t kEMPTY = 0xffffffff;
+
+    static_assert((kCAPACITY & (kCAPACITY - 1)) == 0, "capacity should be power of 2");
+    static_assert(kCAPACITY >= (A3_CHANNELS * 2 + 1) * 2, "PFIFO range should fit in the table");
+
+    register_file_t() : size_(0), entries_() {
+        for (entry_t& entry : entries_) {
+            entry.offset = kEMPTY;
+            entry.value = 0;
+        }
+    }
+
+    // inserts the register with 0 if it is not stored yet
+    uint32_t& operator[](uint32_t offset) {
+        std::size_t i = hash(offset);
+        while (entries_[i].offset != offset) {
+            if (entries_[i].offset == kEMPTY) {
+                ASSERT(size_ < kCAPACITY - 1);
+                entries_[i].offset = offset;
+                ++size_;
+                break;
+            }
+            i = (i + 1) & (kCAPACITY - 1);
+        }
+        return entries_[i].value;
+    }
+
+    // returns nullptr if the register is not stored
+    const uint32_t* find(uint32_t offset) const {
+        for (std::size_t i = hash(offset); entries_[i].offset != kEMPTY; i = (i + 1) & (kCAPACITY - 1)) {
+            if (entries_[i].offset == offset) {
+                return &entries_[i].value;
+            }
+        }
+        return nullptr;
+    }
+
+    std::size_t size() const { return size_; }
+
+ private:
+    struct entry_t {
+        uint32_t offset;
+        uint32_t value;
+    };
+
+    static std::size_t hash(uint32_t offset) {
+        // registers are dword aligned
+        return ((offset >> 2) * 0x9E3779B1U) >> (32 - kSHIFT);
+    }
+
+    static const int kSHIFT = 10;
+    static_assert((1U << kSHIFT) == kCAPACITY, "shift should match capacity");
+
+    std::size_t size_;
+    std::array<entry_t, kCAPACITY> entries_;
+};
+
+}  // namespace a3
+#endif  // A3_REGISTER_FILE_H_
+/* vim: set sw=4 ts=4 et tw=80 : */
@@ -0,0 +1,146 @@
+#ifndef A3_REGISTER_MAP_H_
+#define A3_REGISTER_MAP_H_
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include "pfifo.h"
+namespace a3 {
+
+// BAR0 register virtualization map.
+// Each entry is (offset, handler). Handlers are context member functions
+// declared by A3_BAR0_HANDLERS. Offsets should be sorted in ascending order,
+// this is checked at compile time. Offsets not listed here fall back to the
+// chipset ranges, and then to the hardware registers.
+
+#define A3_BAR0_WRITE_REGISTERS(V)\
+    V(0x001700, bar0_write_virtual)\
+    V(0x001704, bar0_write_bar1_channel)\
+    V(0x001714, bar0_write_bar3_channel)\
+    V(0x002254, bar0_write_poll_area)\
+    V(0x002270, bar0_write_virtual)\
+    V(0x002274, bar0_write_playlist)\
+    V(0x002634, bar0_write_channel_kill)\
+    V(0x022438, bar0_write_ignored)\
+    V(0x070000, bar0_write_pfifo_flush)\
+    V(0x100cb8, bar0_write_virtual)\
+    V(0x100cbc, bar0_write_tlb_flush)\
+    V(0x104050, bar0_write_pcopy_instance)\
+    V(0x104054, bar0_write_pcopy_instance)\
+    V(0x105050, bar0_write_pcopy_instance)\
+    V(0x105054, bar0_write_pcopy_instance)\
+    V(0x121c75, bar0_write_ignored)\
+    V(0x400200, bar0_write_icmd)\
+    V(0x400204, bar0_write_virtual)\
+    V(0x404488, bar0_write_method)\
+    V(0x40448c, bar0_write_virtual)\
+    V(0x409500, bar0_write_virtual)\
+    V(0x409504, bar0_write_wrcmd)\
+    V(0x409b00, bar0_write_ignored)\
+    V(0x4188b4, bar0_write_gpc_bcast)\
+    V(0x4188b8, bar0_write_gpc_bcast)\
+    V(0x610010, bar0_write_pdisplay_objects)
+
+#define A3_BAR0_READ_REGISTERS(V)\
+    V(0x001700, bar0_read_virtual)\
+    V(0x001704, bar0_read_virtual)\
+    V(0x001714, bar0_read_virtual)\
+    V(0x002254, bar0_read_virtual)\
+    V(0x002270, bar0_read_virtual)\
+    V(0x002634, bar0_read_virtual)\
+    V(0x022438, bar0_read_memory_controllers)\
+    V(0x070000, bar0_read_pfifo_flush)\
+    V(0x100cb8, bar0_read_virtual)\
+    V(0x100cbc, bar0_read_virtual)\
+    V(0x104050, bar0_read_pcopy_instance)\
+    V(0x104054, bar0_read_pcopy_instance)\
+    V(0x105050, bar0_read_pcopy_instance)\
+    V(0x105054, bar0_read_pcopy_instance)\
+    V(0x10f20c, bar0_read_memory_partition)\
+    V(0x11020c, bar0_read_memory_partition)\
+    V(0x11120c, bar0_read_memory_partition)\
+    V(0x11220c, bar0_read_memory_partition)\
+    V(0x11320c, bar0_read_memory_partition)\
+    V(0x11420c, bar0_read_memory_partition)\
+    V(0x11520c, bar0_read_memory_partition)\
+    V(0x121c74, bar0_read_memory_controllers)\
+    V(0x409500, bar0_read_virtual)\
+    V(0x409504, bar0_read_virtual)\
+    V(0x409b00, bar0_read_graph_irq_instance)\
+    V(0x4188b4, bar0_read_virtual)\
+    V(0x4188b8, bar0_read_virtual)\
+    V(0x610010, bar0_read_virtual)
+
+// Chipset dependent ranges. (begin, end, write handler, read handler)
+// Since PFIFO is placed differently on NVE0, each chipset has its own list.
+#define A3_BAR0_NVC0_RANGES(V)\
+    V(0x700000, 0x800000, bar0_write_pramin, bar0_read_pramin)\
+    V(pfifo_t::kNVC0_RANGE, pfifo_t::kNVC0_RANGE + A3_CHANNELS * pfifo_t::kCHANNEL_SIZE + 1, bar0_write_pfifo, bar0_read_pfifo)
+
+#define A3_BAR0_NVE0_RANGES(V)\
+    V(0x700000, 0x800000, bar0_write_pramin, bar0_read_pramin)\
+    V(pfifo_t::kNVE0_RANGE, pfifo_t::kNVE0_RANGE + A3_CHANNELS * pfifo_t::kCHANNEL_SIZE + 1, bar0_write_pfifo, bar0_read_pfifo)
+
+#define A3_BAR0_HANDLERS(V)\
+    V(bar0_write_virtual)\
+    V(bar0_write_bar1_channel)\
+    V(bar0_write_bar3_channel)\
+    V(bar0_write_poll_area)\
+    V(bar0_write_playlist)\
+    V(bar0_write_channel_kill)\
+    V(bar0_write_ignored)\
+    V(bar0_write_pfifo_flush)\
+    V(bar0_write_tlb_flush)\
+    V(bar0_write_pcopy_instance)\
+    V(bar0_write_icmd)\
+    V(bar0_write_method)\
+    V(bar0_write_wrcmd)\
+    V(bar0_write_gpc_bcast)\
+    V(bar0_write_pdisplay_objects)\
+    V(bar0_write_pramin)\
+    V(bar0_write_pfifo)\
+    V(bar0_read_virtual)\
+    V(bar0_read_memory_controllers)\
+    V(bar0_read_pfifo_flush)\
+    V(bar0_read_pcopy_instance)\
+    V(bar0_read_memory_partition)\
+    V(bar0_read_graph_irq_instance)\
+    V(bar0_read_pramin)\
+    V(bar0_read_pfifo)
+
+template<typename Handler>
+struct register_entry_t {
+    uint32_t offset;
+    Handler handler;
+};
+
+template<typename Handler>
+struct register_range_t {
+    uint32_t begin;
+    uint32_t end;
+    Handler write;
+    Handler read;
+};
+
+template<typename Handler, std::size_t N>
+constexpr bool is_sorted_register_map(const register_entry_t<Handler> (&map)[N], std::size_t i = 1) {
+    return i >= N || (map[i - 1].offset < map[i].offset && is_sorted_register_map(map, i + 1));
+}
+
+template<typename Handler>
+inline bool register_entry_less(const register_entry_t<Handler>& entry, uint32_t offset) {
+    return entry.offset < offset;
+}
+
+// binary search on the sorted map. returns nullptr if not found
+template<typename Handler, std::size_t N>
+inline Handler lookup_register_map(const register_entry_t<Handler> (&map)[N], uint32_t offset) {
+    const register_entry_t<Handler>* it = std::lower_bound(map, map + N, offset, register_entry_less<Handler>);
+    if (it != map + N && it->offset == offset) {
+        return it->handler;
+    }
+    return nullptr;
+}
+
+}  // namespace a3
+#endif  // A3_REGISTER_MAP_H_
+/* vim: set sw=4 ts=4 et tw=80 : */
@@ -0,0 +1,121 @@
+#ifndef A3_REGISTER_PAGE_H_
+#define A3_REGISTER_PAGE_H_
+#include <cstdint>
+#include <atomic>
+#include "a3.h"
+#include "ring.h"
+namespace a3 {
+
+// BAR0 registers answered from the context's virtual register values
+// without touching the hardware.
+#define A3_CACHED_REGISTERS(V)\
+    V(0x001700)\
+    V(0x001704)\
+    V(0x001714)\
+    V(0x002254)\
+    V(0x002270)\
+    V(0x100cb8)\
+    V(0x100cbc)\
+    V(0x4188b4)\
+    V(0x4188b8)\
+    V(0x610010)
+
+// Read-mostly page shared between A3 and the device model. A3 publishes the
+// virtual register values under a seqlock (odd generation means an update is
+// in progress), and the number of requests it has processed. The device model
+// can answer a cached register read locally only when every request it has
+// submitted is already processed.
+struct register_page_t {
+    enum index_t {
+#define V(offset) REG_##offset,
+        A3_CACHED_REGISTERS(V)
+#undef V
+        kREGISTERS
+    };
+
+    register_page_t()
+        : enabled(0)
+        , processed(0)
+        , generation(0)
+    {
+        for (std::size_t i = 0; i < kREGISTERS; ++i) {
+            values[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    static int index(uint32_t offset) {
+        switch (offset) {
+#define V(offset) case offset: return REG_##offset;
+            A3_CACHED_REGISTERS(V)
+#undef V
+        }
+        return -1;
+    }
+
+    // registers which are constant for a virtualized GPU
+    static bool constant(uint32_t offset, uint32_t* value) {
+        switch (offset) {
+        case 0x022438:  // memory controller size
+        case 0x121c74:
+            *value = A3_MEMORY_CTL_NUM;
+            return true;
+        case 0x11020c:  // psize
+        case 0x11120c:
+        case 0x11220c:
+        case 0x11320c:
+        case 0x11420c:
+        case 0x11520c:
+        case 0x10f20c:  // bsize
+            *value = A3_MEMORY_CTL_PART >> 20;
+            return true;
+        }
+        return false;
+    }
+
+    // A3 side. only the session thread of the context publishes
+    void publish(uint32_t offset, uint32_t value) {
+        const int i = index(offset);
+        if (i < 0) {
+            return;
+        }
+        generation.fetch_add(1, std::memory_order_acq_rel);
+        values[i].store(value, std::memory_order_relaxed);
+        generation.fetch_add(1, std::memory_order_release);
+    }
+
+    // device model side
+    bool lookup(uint32_t offset, uint32_t* value) const {
+        if (!enabled.load(std::memory_order_acquire)) {
+            return false;
+        }
+        if (constant(offset, value)) {
+            return true;
+        }
+        const int i = index(offset);
+        if (i < 0) {
+            return false;
+        }
+        while (true) {
+            const uint32_t before = generation.load(std::memory_order_acquire);
+            if (before & 1) {
+                cpu_relax();
+                continue;
+            }
+            *value = values[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (generation.load(std::memory_order_relaxed) == before) {
+                return true;
+            }
+        }
+    }
+
+    std::atomic<uint32_t> enabled;
+    std::atomic<uint32_t> processed;
+    char pad_[kCACHE_LINE_SIZE - sizeof(std::atomic<uint32_t>) * 2];
+    std::atomic<uint32_t> generation;
+    std::atomic<uint32_t> values[kREGISTERS];
+};
+
+}  // namespace a3
+#endif  // A3_REGISTER_PAGE_H_
+/* vim: set sw=4 ts=4 et tw=80 : */
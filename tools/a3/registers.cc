@@ -28,7 +28,7 @@ namespace a3 {
 namespace registers {
 
 accessor::accessor()
-    : lock_(a3::device()->mutex()) {
+    : lock_(a3::device()->register_mutex()) {
 }
 
 uint32_t accessor::read(uint32_t offset, std::size_t size) {
@@ -0,0 +1,170 @@
+/*
+ * A3 command stream replay benchmark
+ *
+ * Copyright (c) 2012-2013 Yusuke Suzuki
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include "a3.h"
+#include "cmdline.h"
+#include "context.h"
+#include "device.h"
+#include "recorder.h"
+#include "session.h"
+#include "trace.h"
+namespace a3 {
+
+// Replays recorded command streams against A3 without the device model.
+// Each stream is replayed by its own thread, as each guest session does.
+struct replay_result_t {
+    replay_result_t() : commands(0), elapsed(0), latencies() { }
+    uint64_t commands;
+    uint64_t elapsed;  // ns
+    std::vector<uint64_t> latencies;  // ns
+};
+
+static void replay_stream(const std::string path, bool through, bool paced, replay_result_t* result) {
+    record_reader_t reader(path);
+    if (!reader.is_open()) {
+        A3_FATAL(stderr, "Cannot open record file: %s\n", path.c_str());
+        return;
+    }
+    boost::asio::io_service io_service;
+    session session(io_service);
+    session.start_replay(through);
+
+    record_t record;
+    std::vector<uint8_t> payload;
+    uint64_t origin = 0;
+    const uint64_t start = trace::now();
+    while (reader.next(&record, &payload)) {
+        if (!origin) {
+            origin = record.timestamp;
+        }
+        if (paced) {
+            // keep the recorded inter-arrival gaps
+            const uint64_t due = start + (record.timestamp - origin);
+            for (uint64_t now = trace::now(); now < due; now = trace::now()) {
+                if (due - now > 100000) {
+                    boost::this_thread::sleep(boost::posix_time::microseconds((due - now) / 1000));
+                }
+            }
+        }
+        const uint64_t begin = trace::now();
+        session.replay(record.cmd, payload);
+        result->latencies.push_back(trace::now() - begin);
+        ++result->commands;
+    }
+    result->elapsed = trace::now() - start;
+}
+
+static uint64_t percentile(const std::vector<uint64_t>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    const std::size_t index = std::min<std::size_t>(sorted.size() - 1, static_cast<std::size_t>(sorted.size() * p));
+    return sorted[index];
+}
+
+}  // namespace a3
+
+int main(int argc, char** argv) {
+    namespace c = a3;
+    c::cmdline::Parser cmd("a3-replay");
+
+    cmd.Add("help", "help", 'h', "print this message");
+    cmd.Add("through", "through", 't', "through I/O");
+    cmd.Add("simulate", "simulate", 0, "Replay on the simulated NVC0 instead of the device");
+    cmd.Add("paced", "paced", 0, "Keep the recorded timing instead of replaying back-to-back");
+    cmd.set_footer("[bdf] record_files");
+
+    if (!cmd.Parse(argc, argv)) {
+        std::fprintf(stderr, "%s\n%s", cmd.error().c_str(), cmd.usage().c_str());
+        return 1;
+    }
+
+    if (cmd.Exist("help")) {
+        std::fputs(cmd.usage().c_str(), stdout);
+        return 1;
+    }
+
+    c::flags::simulate = cmd.Exist("simulate");
+
+    // bdf is not needed for the simulated device
+    std::vector<std::string> files(cmd.rest());
+
+    c::bdf bdf = { { { 0, 0, 0 } } };
+
+    if (!c::flags::simulate) {
+        if (files.empty() || ((bdf.raw = strtol(files.front().c_str(), nullptr, 16)) == 0)) {
+            A3_FPRINTF(stderr, "Usage: a3-replay bdf record_files...\n");
+            return 1;
+        }
+        files.erase(files.begin());
+    }
+
+    if (files.empty()) {
+        A3_FPRINTF(stderr, "Usage: a3-replay [--simulate] [bdf] record_files...\n");
+        return 1;
+    }
+
+    c::device()->initialize(bdf);
+
+    const bool through = cmd.Exist("through");
+    const bool paced = cmd.Exist("paced");
+    std::vector<c::replay_result_t> results(files.size());
+    boost::thread_group threads;
+    const uint64_t start = c::trace::now();
+    for (std::size_t i = 0, iz = files.size(); i < iz; ++i) {
+        threads.create_thread(boost::bind(&c::replay_stream, files[i], through, paced, &results[i]));
+    }
+    threads.join_all();
+    const uint64_t elapsed = c::trace::now() - start;
+
+    std::vector<uint64_t> latencies;
+    uint64_t commands = 0;
+    for (std::size_t i = 0, iz = results.size(); i < iz; ++i) {
+        const c::replay_result_t& result = results[i];
+        std::printf("%s: %" PRIu64 " commands in %" PRIu64 " ns\n", files[i].c_str(), result.commands, result.elapsed);
+        commands += result.commands;
+        latencies.insert(latencies.end(), result.latencies.begin(), result.latencies.end());
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    std::printf("commands   %" PRIu64 "\n", commands);
+    std::printf("elapsed    %" PRIu64 " ns\n", elapsed);
+    std::printf("throughput %.1f commands/s\n", elapsed ? commands * 1e9 / elapsed : 0.0);
+    std::printf("p50        %" PRIu64 " ns\n", c::percentile(latencies, 0.5));
+    std::printf("p90        %" PRIu64 " ns\n", c::percentile(latencies, 0.9));
+    std::printf("p99        %" PRIu64 " ns\n", c::percentile(latencies, 0.99));
+    std::printf("p99.9      %" PRIu64 " ns\n", c::percentile(latencies, 0.999));
+    std::printf("max        %" PRIu64 " ns\n", latencies.empty() ? 0 : latencies.back());
+    return 0;
+}
+/* vim: set sw=4 ts=4 et tw=80 : */
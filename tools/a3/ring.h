@@ -0,0 +1,120 @@
+#ifndef A3_RING_H_
+#define A3_RING_H_
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <boost/noncopyable.hpp>
+#include "a3.h"
+namespace a3 {
+
+static const std::size_t kCACHE_LINE_SIZE = 64;
+
+namespace ring_detail {
+
+inline void futex_wait(std::atomic<uint32_t>* addr, uint32_t expected) {
+    // shared futex, since producer and consumer live in different processes
+    ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAIT, expected, nullptr, nullptr, 0);
+}
+
+inline void futex_wake(std::atomic<uint32_t>* addr) {
+    ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+// Spin count adapts to the observed latency of the other side.
+// When the waiter is satisfied while spinning, it spins longer next time.
+// When it falls back to futex, it spins shorter.
+class spinner_t {
+ public:
+    static const uint32_t kMIN_SPIN = 64;
+    static const uint32_t kMAX_SPIN = 1 << 16;
+
+    spinner_t() : spin_(kMIN_SPIN * 16) { }
+    uint32_t spin() const { return spin_; }
+    void hit() { if (spin_ < kMAX_SPIN) { spin_ <<= 1; } }
+    void miss() { if (spin_ > kMIN_SPIN) { spin_ >>= 1; } }
+
+ private:
+    uint32_t spin_;
+};
+
+}  // namespace ring_detail
+
+// Lock-free single producer / single consumer ring.
+// This object is placed in process shared memory, so it must not have any
+// pointer members. head_ is only written by the consumer, tail_ is only
+// written by the producer, and each of them lives in its own cache line.
+template<typename T, std::size_t N>
+class ring_t : private boost::noncopyable {
+ public:
+    static_assert((N & (N - 1)) == 0, "ring size should be power of 2");
+    static const uint32_t kMASK = N - 1;
+
+    ring_t()
+        : head_(0)
+        , tail_(0)
+        , consumer_waiting_(0)
+        , producer_waiting_(0)
+    {
+    }
+
+    void push(const T& value, ring_detail::spinner_t* spinner) {
+        const uint32_t tail = tail_.load(std::memory_order_relaxed);
+        wait_while_equal(&head_, tail - N, &producer_waiting_, spinner);
+        slots_[tail & kMASK] = value;
+        tail_.store(tail + 1, std::memory_order_seq_cst);
+        if (consumer_waiting_.load(std::memory_order_seq_cst)) {
+            ring_detail::futex_wake(&tail_);
+        }
+    }
+
+    void pop(T* value, ring_detail::spinner_t* spinner) {
+        const uint32_t head = head_.load(std::memory_order_relaxed);
+        wait_while_equal(&tail_, head, &consumer_waiting_, spinner);
+        *value = slots_[head & kMASK];
+        head_.store(head + 1, std::memory_order_seq_cst);
+        if (producer_waiting_.load(std::memory_order_seq_cst)) {
+            ring_detail::futex_wake(&head_);
+        }
+    }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+ private:
+    // Wait until *word != value. Spin first, and then sleep on futex.
+    static void wait_while_equal(std::atomic<uint32_t>* word, uint32_t value, std::atomic<uint32_t>* waiting, ring_detail::spinner_t* spinner) {
+        for (uint32_t i = 0, iz = spinner->spin(); i < iz; ++i) {
+            if (word->load(std::memory_order_acquire) != value) {
+                spinner->hit();
+                return;
+            }
+            cpu_relax();
+        }
+        spinner->miss();
+        waiting->store(1, std::memory_order_seq_cst);
+        uint32_t current;
+        while ((current = word->load(std::memory_order_seq_cst)) == value) {
+            ring_detail::futex_wait(word, current);
+        }
+        waiting->store(0, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint32_t> head_;
+    char pad0_[kCACHE_LINE_SIZE - sizeof(std::atomic<uint32_t>)];
+    std::atomic<uint32_t> tail_;
+    char pad1_[kCACHE_LINE_SIZE - sizeof(std::atomic<uint32_t>)];
+    std::atomic<uint32_t> consumer_waiting_;
+    char pad2_[kCACHE_LINE_SIZE - sizeof(std::atomic<uint32_t>)];
+    std::atomic<uint32_t> producer_waiting_;
+    char pad3_[kCACHE_LINE_SIZE - sizeof(std::atomic<uint32_t>)];
+    T slots_[N];
+};
+
+}  // namespace a3
+#endif  // A3_RING_H_
+/* vim: set sw=4 ts=4 et tw=80 : */
@@ -21,10 +21,17 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
  */
+#include <cerrno>
 #include <cstdint>
+#include <algorithm>
+#include <time.h>
+#include <sys/prctl.h>
+#include <boost/thread.hpp>
 #include "a3.h"
 #include "scheduler.h"
 #include "context.h"
+#include "device.h"
+#include "trace.h"
 namespace a3 {
 
 void scheduler_t::register_context(context* ctx) {
@@ -39,5 +46,40 @@ void scheduler_t::unregister_context(context* ctx) {
     }
 }
 
+// With the default 50us timer slack, a 1us sleep lasts 50us or more. The
+// slack of the calling scheduler thread is dropped to 1ns, so that the
+// backoff steps keep their length.
+static void backoff_sleep(const duration_t& duration) {
+    static __thread bool slack_reduced = false;
+    if (!slack_reduced) {
+        ::prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+        slack_reduced = true;
+    }
+    const int64_t ns = duration.total_microseconds() * 1000;
+    struct timespec ts = { static_cast<time_t>(ns / 1000000000), static_cast<long>(ns % 1000000000) };
+    while (::clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, &ts) == EINTR) {
+    }
+}
+
+duration_t scheduler_t::wait_completion(context* ctx, const timer_t& timer) {
+    // short kernels finish within the spin, keeping their measurement exact.
+    // past it, completion is observed one backoff step plus the wakeup
+    // latency late at most.
+    const duration_t spin = boost::posix_time::microseconds(20);
+    const duration_t max_backoff = boost::posix_time::microseconds(50);
+    duration_t backoff = boost::posix_time::microseconds(1);
+    const uint64_t start = trace::enabled(trace::CATEGORY_SCHEDULER, trace::LEVEL_INFO) ? trace::now() : 0;
+    while (device()->is_active(ctx)) {
+        if (timer.elapsed() < spin) {
+            cpu_relax();
+            continue;
+        }
+        backoff_sleep(backoff);
+        backoff = std::min(backoff * 2, max_backoff);
+    }
+    trace::record_event(trace::CATEGORY_SCHEDULER, trace::LEVEL_INFO, trace::EVENT_SCHEDULER_COMPLETION, ctx->id(), 0, 0, start);
+    return timer.elapsed();
+}
+
 }  // namespace a3
 /* vim: set sw=4 ts=4 et tw=80 : */
@@ -5,6 +5,8 @@
 #include <boost/intrusive/list.hpp>
 #include "a3.h"
 #include "context.h"
+#include "duration.h"
+#include "timer.h"
 namespace a3 {
 
 class scheduler_t : private boost::noncopyable {
@@ -27,6 +29,12 @@ class scheduler_t : private boost::noncopyable {
     virtual void on_register_context(context* ctx) { }
     virtual void on_unregister_context(context* ctx) { }
 
+    // Waits until the GPU has drained the work submitted for ctx and returns
+    // the elapsed time of timer at that point. Polls tightly for a short
+    // while, then sleeps between polls with exponential backoff, so a long
+    // running kernel does not keep a host core busy.
+    duration_t wait_completion(context* ctx, const timer_t& timer);
+
  private:
     contexts_t contexts_;
     boost::mutex fire_mutex_;
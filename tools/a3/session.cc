@@ -22,16 +22,24 @@
  * THE SOFTWARE.
  */
 #include <cstdio>
+#include <algorithm>
+#include <cstring>
 #include "session.h"
 #include "context.h"
+#include "flags.h"
+#include "trace.h"
 namespace a3 {
 
+const uint32_t batch_area_t::kENTRIES;
+
 session::session(boost::asio::io_service& io_service)
     : socket_(io_service)
     , context_(nullptr)
     , thread_(nullptr)
-    , req_queue_(nullptr)
-    , res_queue_(nullptr)
+    , transport_(nullptr)
+    , batch_(nullptr)
+    , recorder_(nullptr)
+    , replaying_(false)
 {
 }
 
@@ -49,56 +57,101 @@ void session::start(bool through) {
 	  boost::bind(&session::handle_read, this, boost::asio::placeholders::error));
 }
 
+void session::start_replay(bool through) {
+    replaying_ = true;
+    context_.reset(new context(this, through));
+}
+
+bool session::replay(const command& cmd, const std::vector<uint8_t>& payload) {
+    if (cmd.type == command::TYPE_BATCH) {
+        std::memcpy((*batch_)->buffer(cmd.offset), payload.data(), std::min<std::size_t>(payload.size(), sizeof(command) * batch_area_t::kENTRIES));
+        handle_batch(cmd);
+        return false;
+    }
+    return ctx()->handle(cmd);
+}
+
+void session::record(uint64_t timestamp, const command& cmd) {
+    if (cmd.type == command::TYPE_BATCH) {
+        const uint32_t count = std::min(cmd.value, batch_area_t::kENTRIES);
+        recorder_->record(timestamp, cmd, (*batch_)->buffer(cmd.offset), count * sizeof(command));
+    } else {
+        recorder_->record(timestamp, cmd);
+    }
+}
+
 void session::main() {
     // this is main loop of message queue handling
-    unsigned int priority;
-    std::size_t size;
-    A3_LOG("main loop start\n");
+    A3_LOG("main loop start with %s transport\n", transport_t::name(transport_->type()));
     for (;;) {
         command cmd;
-        req_queue_->receive(&cmd, sizeof(command), size, priority);
-        if (ctx()->handle(cmd)) {
+        transport_->receive_request(&cmd);
+        if (recorder_) {
+            record(trace::now(), cmd);
+        }
+        if (cmd.type == command::TYPE_BATCH) {
+            handle_batch(cmd);
+            ctx()->register_page()->processed.fetch_add(1, std::memory_order_release);
+            continue;
+        }
+        const bool response = ctx()->handle(cmd);
+        // published before the response, so the device model can answer the
+        // next cached register read locally
+        ctx()->register_page()->processed.fetch_add(1, std::memory_order_release);
+        if (response) {
             // res queue is needed
-            res_queue_->send(buffer(), sizeof(command), 0);
+            transport_->send_response(*buffer());
         }
     }
 }
 
-void session::initialize(uint32_t id) {
-    std::vector<char> name(200);
-
-    // request queue
-    {
-        const int ret = std::snprintf(name.data(), name.size() - 1, "a3_shared_req_queue_%u", id);
-        if (ret < 0) {
-            std::perror(nullptr);
-            std::exit(1);
-        }
-        name[ret] = '\0';
-
-        // delete queue
-        interprocess::message_queue::remove(name.data());
-
-        // construct new queue
-        req_queue_.reset(new interprocess::message_queue(interprocess::create_only, name.data(), 0x100000, sizeof(a3::command)));
-    }
+static bool is_span_write(const command& cmd) {
+    return cmd.type == command::TYPE_WRITE &&
+        (cmd.bar() == command::BAR1 || cmd.bar() == command::BAR3) &&
+        cmd.size() == sizeof(uint32_t) &&
+        !(cmd.offset & 0x3);
+}
 
-    // response queue
-    {
-        const int ret = std::snprintf(name.data(), name.size() - 1, "a3_shared_res_queue_%u", id);
-        if (ret < 0) {
-            std::perror(nullptr);
-            std::exit(1);
+void session::handle_batch(const command& cmd) {
+    // batched commands are posted writes, so they never need responses
+    const uint32_t seq = cmd.offset;
+    const command* entries = (*batch_)->buffer(seq);
+    for (uint32_t i = 0, iz = std::min(cmd.value, batch_area_t::kENTRIES); i < iz;) {
+        const command& head = entries[i];
+        uint32_t j = i + 1;
+        if (is_span_write(head)) {
+            // consecutive dword writes to BAR1/BAR3 (memcpy by the guest) are
+            // moved as one span
+            while (j < iz &&
+                   is_span_write(entries[j]) &&
+                   entries[j].bar() == head.bar() &&
+                   entries[j].offset == head.offset + (j - i) * sizeof(uint32_t)) {
+                ++j;
+            }
         }
-        name[ret] = '\0';
-
-        // delete queue
-        interprocess::message_queue::remove(name.data());
-
-        // construct new queue
-        res_queue_.reset(new interprocess::message_queue(interprocess::create_only, name.data(), 0x100000, sizeof(a3::command)));
+        if (j - i > 1) {
+            // the recorder already has the whole batch (session::record)
+            ctx()->write_span(entries + i, j - i);
+        } else {
+            ctx()->handle(head);
+        }
+        i = j;
     }
+    (*batch_)->consume(seq);
+}
 
+void session::initialize(uint32_t id) {
+    if (replaying_) {
+        batch_.reset(new shared_region_t<batch_area_t>(true, shared_name("a3_replay_batch_%u", id)));
+        return;
+    }
+    if (!flags::record.empty()) {
+        const std::string path = flags::record + shared_name("/a3-record-%u.bin", id);
+        recorder_.reset(new recorder_t(path));
+        A3_LOG("recording commands to %s\n", path.c_str());
+    }
+    transport_.reset(transport_t::create(static_cast<transport_t::type_t>(flags::transport), id));
+    batch_.reset(new shared_region_t<batch_area_t>(true, shared_name("a3_shared_batch_%u", id)));
     thread_.reset(new boost::thread(&session::main, this));
 }
 
@@ -108,7 +161,11 @@ void session::handle_read(const boost::system::error_code& error) {
         return;
     }
     const command command(*buffer());
+    const uint64_t timestamp = trace::now();
     ctx()->handle(command);
+    if (recorder_) {
+        recorder_->record(timestamp, command);
+    }
 
     // handle command
     boost::asio::async_write(
@@ -7,8 +7,11 @@
 #include <boost/type_traits/aligned_storage.hpp>
 #include <boost/type_traits/alignment_of.hpp>
 #include <boost/thread.hpp>
-#include <boost/interprocess/ipc/message_queue.hpp>
 #include "a3.h"
+#include "transport.h"
+#include "batch.h"
+#include "shared_region.h"
+#include "recorder.h"
 namespace a3 {
 
 class context;
@@ -20,22 +23,31 @@ class session : private boost::noncopyable {
     virtual ~session();
     session(boost::asio::io_service& io_service);
     void start(bool through);
+    // replay recorded commands without the device model
+    void start_replay(bool through);
+    bool replay(const command& cmd, const std::vector<uint8_t>& payload);
     boost::asio::local::stream_protocol::socket& socket() { return socket_; }
     command* buffer() { return reinterpret_cast<a3::command*>(&buffer_); }
     context* ctx() const { return context_.get(); }
     void initialize(uint32_t id);
+    // a3-replay session, its shared memory must not clash with a running A3
+    bool replaying() const { return replaying_; }
 
  private:
     void handle_read(const boost::system::error_code& error);
     void handle_write(const boost::system::error_code& error);
     void main();
+    void handle_batch(const command& cmd);
+    void record(uint64_t timestamp, const command& cmd);
 
     boost::asio::local::stream_protocol::socket socket_;
     boost::aligned_storage<kCommandSize, boost::alignment_of<command>::value>::type buffer_;
     std::unique_ptr<context> context_;
     std::unique_ptr<boost::thread> thread_;
-    std::unique_ptr<interprocess::message_queue> req_queue_;
-    std::unique_ptr<interprocess::message_queue> res_queue_;
+    std::unique_ptr<transport_t> transport_;
+    std::unique_ptr<shared_region_t<batch_area_t>> batch_;
+    std::unique_ptr<recorder_t> recorder_;
+    bool replaying_;
 };
 
 
@@ -24,12 +24,18 @@
 
 #include <cstdint>
 #include <cinttypes>
+#include <algorithm>
+#include <vector>
 #include <boost/make_shared.hpp>
+#include "barrier.h"
 #include "bit_mask.h"
 #include "shadow_page_table.h"
 #include "pmem.h"
 #include "page.h"
 #include "context.h"
+#include "device.h"
+#include "worker_pool.h"
+#include "trace.h"
 namespace a3 {
 
 shadow_page_table::shadow_page_table(uint32_t channel_id)
@@ -39,7 +45,13 @@ shadow_page_table::shadow_page_table(uint32_t channel_id)
     , large_pages_pool_()
     , small_pages_pool_()
     , large_pages_pool_cursor_()
-    , small_pages_pool_cursor_() {
+    , small_pages_pool_cursor_()
+    , tracked_(false)
+    , overflowed_(false)
+    , tracked_address_()
+    , directories_()
+    , tables_()
+    , dirty_() {
 }
 
 void shadow_page_table::set_low_size(uint32_t value) {
@@ -85,7 +97,18 @@ bool shadow_page_table::refresh(context* ctx, uint64_t page_directory_address, u
 }
 
 void shadow_page_table::refresh_page_directories(context* ctx, uint64_t address) {
-    pmem::accessor pmem;
+    // the guest may have remapped its memory since the last refresh
+    ctx->p2m()->synchronize();
+    if (tracked_ && !overflowed_ && tracked_address_ == address) {
+        refresh_dirty(ctx);
+        return;
+    }
+
+    // full rescan
+    const uint64_t start = trace::enabled(trace::CATEGORY_SHADOW, trace::LEVEL_INFO) ? trace::now() : 0;
+    untrack(ctx);
+    ctx->instruments()->increment_rescan_times();
+
     page_directory_address_ = address;
     large_pages_pool_cursor_ = 0;
     small_pages_pool_cursor_ = 0;
@@ -101,35 +124,205 @@ void shadow_page_table::refresh_page_directories(context* ctx, uint64_t address)
         return;
     }
 
+    // read the whole guest directory before touching the shadow pages,
+    // so the PRAMIN window does not bounce between them
+    pmem::batch_t words(0x10000 / sizeof(uint32_t));
+    for (std::size_t i = 0; i < words.size(); ++i) {
+        words[i].addr = page_directory_address() + i * sizeof(uint32_t);
+    }
+    {
+        pmem::accessor pmem;
+        pmem.read32(&words);
+    }
+
+    // allocate shadow tables sequentially, then fill them in parallel.
+    // pool cursors are reset, so no table of the previous scan is kept
+    directories_.assign(0x10000 / 0x8, directory_state());
+    std::vector<uint32_t> table(words.size());
+    std::vector<uint32_t> present;
     for (uint64_t offset = 0, index = 0; offset < 0x10000; offset += 0x8, ++index) {
-        const struct page_directory res = page_directory::create(&pmem, page_directory_address() + offset);
+        struct page_directory res = { };
+        res.word0 = words[index * 2].value;
+        res.word1 = words[index * 2 + 1].value;
         if (res.large_page_table_present || res.small_page_table_present) {
             // A3_LOG("  dir 0x%010" PRIx64 "\n", index * kPAGE_DIRECTORY_COVERED_SIZE);
+            present.push_back(index);
         }
-        struct page_directory result = refresh_directory(ctx, &pmem, res);
-        phys()->write32(offset, result.word0);
-        phys()->write32(offset + 0x4, result.word1);
+        struct page_directory result = prepare_directory(ctx, index, res);
+        table[index * 2] = result.word0;
+        table[index * 2 + 1] = result.word1;
     }
+
+    const worker_pool_t::function_t refresh = [this, ctx, &present](std::size_t i) {
+        refresh_tables(ctx, present[i]);
+    };
+    if (device()->pmem_mutex().owned()) {
+        // workers would wait for the pmem lock held by the caller
+        for (std::size_t i = 0; i < present.size(); ++i) {
+            refresh(i);
+        }
+    } else {
+        shadow_workers()->parallel_for(present.size(), refresh);
+    }
+
+    // join done, publish the directory
+    phys()->write_block(0, table.data(), 0x10000);
+
+    track(ctx, address, 0x10000, kDIRECTORY_KEY);
+    tracked_ = true;
+    tracked_address_ = address;
     A3_LOG("scan page table of channel id 0x%" PRIi32 " : pd 0x%" PRIX64 "\n", channel_id(), page_directory_address());
+    trace::record_event(trace::CATEGORY_SHADOW, trace::LEVEL_INFO, trace::EVENT_SHADOW_RESCAN, ctx->id(), address, channel_id(), start);
+}
+
+void shadow_page_table::track(context* ctx, uint64_t address, uint64_t size, uint32_t key) {
+    for (uint64_t page = bit_clear<kPAGE_SHIFT>(address); page < (address + size); page += kPAGE_SIZE) {
+        if (!ctx->barrier()->map(page)) {
+            // BAR1 / BAR3 remapping must stop exposing it to the guest
+            ctx->barrier_changed(page);
+        }
+        ctx->guest_page_table_map()->insert(std::make_pair(page, this));
+        tables_.insert(std::make_pair(page, key));
+    }
+}
+
+static void erase_tracked(context* ctx, shadow_page_table* table, uint64_t page) {
+    if (!ctx->barrier()->unmap(page)) {
+        ctx->barrier_changed(page);
+    }
+    typedef context::page_table_map::iterator iter_t;
+    const std::pair<iter_t, iter_t> range = ctx->guest_page_table_map()->equal_range(page);
+    for (iter_t it = range.first; it != range.second; ++it) {
+        if (it->second == table) {
+            ctx->guest_page_table_map()->erase(it);
+            break;
+        }
+    }
+}
+
+void shadow_page_table::untrack(context* ctx) {
+    for (const auto& pair : tables_) {
+        erase_tracked(ctx, this, pair.first);
+    }
+    tables_.clear();
+    dirty_.clear();
+    tracked_ = false;
+    overflowed_ = false;
 }
 
-struct page_directory shadow_page_table::refresh_directory(context* ctx, pmem::accessor* pmem, const struct page_directory& dir) {
+void shadow_page_table::untrack_directory(context* ctx, uint32_t index) {
+    const directory_state& state = directories_[index];
+    const uint64_t sizes[] = {
+        state.guest.large_page_table_present ? page_directory::large_size_count(state.guest) * 0x8 : 0,
+        state.guest.small_page_table_present ? kSMALL_PAGE_COUNT * 0x8 : 0
+    };
+    const uint64_t addresses[] = { state.large_address, state.small_address };
+    const uint32_t keys[] = { table_key(index, true), table_key(index, false) };
+    for (int i = 0; i < 2; ++i) {
+        for (uint64_t page = bit_clear<kPAGE_SHIFT>(addresses[i]); page < (addresses[i] + sizes[i]); page += kPAGE_SIZE) {
+            typedef boost::unordered_multimap<uint64_t, uint32_t>::iterator iter_t;
+            const std::pair<iter_t, iter_t> range = tables_.equal_range(page);
+            for (iter_t it = range.first; it != range.second; ++it) {
+                if (it->second == keys[i]) {
+                    tables_.erase(it);
+                    erase_tracked(ctx, this, page);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void shadow_page_table::mark_dirty(uint64_t address) {
+    if (!tracked_ || overflowed_) {
+        return;
+    }
+    if (dirty_.size() == kMAX_DIRTY_ENTRIES) {
+        overflowed_ = true;
+        dirty_.clear();
+        return;
+    }
+    dirty_.push_back(bit_clear<3>(address));
+}
+
+void shadow_page_table::refresh_dirty(context* ctx) {
+    if (dirty_.empty()) {
+        return;
+    }
+    const uint64_t start = trace::enabled(trace::CATEGORY_SHADOW, trace::LEVEL_DEBUG) ? trace::now() : 0;
+    std::vector<uint64_t> dirty;
+    dirty.swap(dirty_);
+    std::sort(dirty.begin(), dirty.end());
+    dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+    pmem::accessor pmem;
+    for (uint64_t address : dirty) {
+        if (page_directory_address() <= address && address < (page_directory_address() + 0x10000)) {
+            refresh_dirty_directory(ctx, &pmem, (address - page_directory_address()) / 0x8);
+        }
+        refresh_dirty_entry(ctx, &pmem, address);
+    }
+    A3_LOG("re-shadow %" PRIu64 " entries of channel id 0x%" PRIi32 "\n", static_cast<uint64_t>(dirty.size()), channel_id());
+    trace::record_event(trace::CATEGORY_SHADOW, trace::LEVEL_DEBUG, trace::EVENT_SHADOW_DIRTY, ctx->id(), page_directory_address(), dirty.size(), start);
+}
+
+void shadow_page_table::refresh_dirty_directory(context* ctx, pmem::accessor* pmem, uint32_t index) {
+    const uint64_t offset = index * 0x8;
+    const struct page_directory dir = page_directory::create(pmem, page_directory_address() + offset);
+    if (dir.raw == directories_[index].guest.raw) {
+        // tables are tracked by themselves
+        return;
+    }
+    untrack_directory(ctx, index);
+    const struct page_directory result = prepare_directory(ctx, index, dir);
+    refresh_tables(ctx, index);
+    phys()->write32(offset, result.word0);
+    phys()->write32(offset + 0x4, result.word1);
+}
+
+void shadow_page_table::refresh_dirty_entry(context* ctx, pmem::accessor* pmem, uint64_t address) {
+    typedef boost::unordered_multimap<uint64_t, uint32_t>::iterator iter_t;
+    const std::pair<iter_t, iter_t> range = tables_.equal_range(bit_clear<kPAGE_SHIFT>(address));
+    for (iter_t it = range.first; it != range.second; ++it) {
+        if (it->second == kDIRECTORY_KEY) {
+            continue;
+        }
+        const bool large = it->second & 1;
+        const directory_state& state = directories_[it->second >> 1];
+        const uint64_t base = large ? state.large_address : state.small_address;
+        const uint64_t count = large ? page_directory::large_size_count(state.guest) : kSMALL_PAGE_COUNT;
+        if (address < base || address >= (base + count * 0x8)) {
+            continue;
+        }
+        page* shadow = large ? state.large_page : state.small_page;
+        struct page_entry entry;
+        struct page_entry res = { };
+        if (page_entry::create(pmem, address, &entry)) {
+            res = refresh_entry(ctx, entry);
+        }
+        shadow->write32(address - base, res.word0);
+        shadow->write32(address - base + 0x4, res.word1);
+    }
+}
+
+struct page_directory shadow_page_table::prepare_directory(context* ctx, uint32_t index, const struct page_directory& dir) {
     struct page_directory result(dir);
+    directory_state& state = directories_[index];
+    // shadow tables of a rewritten directory are kept even when it becomes
+    // non-present and reused later; pool pages are only given back by the
+    // full rescan. tables always have the maximum size
+    page* const previous_large = state.large_page;
+    page* const previous_small = state.small_page;
+    state = directory_state();
+    state.guest = dir;
+    state.large_page = previous_large;
+    state.small_page = previous_small;
     if (dir.large_page_table_present) {
         const uint64_t address = ctx->get_phys_address(static_cast<uint64_t>(dir.large_page_table_address) << 12);
-        page* large_page = allocate_large_page();
-        for (uint64_t i = 0, iz = page_directory::large_size_count(dir); i < iz; ++i) {
-            const uint64_t item = 0x8 * i;
-            struct page_entry entry;
-            if (page_entry::create(pmem, address + item, &entry)) {
-                struct page_entry res = refresh_entry(ctx, pmem, entry);
-                large_page->write32(item, res.word0);
-                large_page->write32(item + 0x4, res.word1);
-                // A3_LOG("    large 0x%010" PRIx64 " => 0x%010" PRIx64 "\n", i * kLARGE_PAGE_SIZE, res.address);
-            } else {
-                large_page->write32(item, 0);
-            }
-        }
+        page* large_page = previous_large ? previous_large : allocate_large_page();
+        state.large_address = address;
+        state.large_page = large_page;
+        track(ctx, address, page_directory::large_size_count(dir) * 0x8, table_key(index, true));
         const uint64_t result_address = (large_page->address() >> 12);
         result.large_page_table_address = result_address;
     } else {
@@ -138,19 +331,10 @@ struct page_directory shadow_page_table::refresh_directory(context* ctx, pmem::a
 
     if (dir.small_page_table_present) {
         const uint64_t address = ctx->get_phys_address(static_cast<uint64_t>(dir.small_page_table_address) << 12);
-        page* small_page = allocate_small_page();
-        for (uint64_t i = 0, iz = kSMALL_PAGE_COUNT; i < iz; ++i) {
-            const uint64_t item = 0x8 * i;
-            struct page_entry entry;
-            if (page_entry::create(pmem, address + item, &entry)) {
-                struct page_entry res = refresh_entry(ctx, pmem, entry);
-                small_page->write32(item, res.word0);
-                small_page->write32(item + 0x4, res.word1);
-                // A3_LOG("    small 0x%010" PRIx64 " => 0x%010" PRIx64 "\n", i * kSMALL_PAGE_SIZE, res.address);
-            } else {
-                small_page->write32(item, 0);
-            }
-        }
+        page* small_page = previous_small ? previous_small : allocate_small_page();
+        state.small_address = address;
+        state.small_page = small_page;
+        track(ctx, address, kSMALL_PAGE_COUNT * 0x8, table_key(index, false));
         const uint64_t result_address = (small_page->address() >> 12);
         result.small_page_table_address = result_address;
     } else {
@@ -160,7 +344,54 @@ struct page_directory shadow_page_table::refresh_directory(context* ctx, pmem::a
     return result;
 }
 
-struct page_entry shadow_page_table::refresh_entry(context* ctx, pmem::accessor* pmem, const struct page_entry& entry) {
+// thread safe, touches only the tables of the directory
+void shadow_page_table::refresh_tables(context* ctx, uint32_t index) {
+    const directory_state& state = directories_[index];
+    if (state.guest.large_page_table_present) {
+        refresh_table(ctx, state.large_address, page_directory::large_size_count(state.guest), state.large_page);
+    }
+    if (state.guest.small_page_table_present) {
+        refresh_table(ctx, state.small_address, kSMALL_PAGE_COUNT, state.small_page);
+    }
+}
+
+void shadow_page_table::refresh_table(context* ctx, uint64_t address, uint64_t count, page* shadow) {
+    // guest entries are read into local buffers first, word1 only for
+    // present entries. pmem is locked only while reading
+    pmem::batch_t lower(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        lower[i].addr = address + 0x8 * i;
+    }
+    pmem::batch_t upper;
+    {
+        pmem::accessor pmem;
+        pmem.read32(&lower);
+        for (uint64_t i = 0; i < count; ++i) {
+            struct page_entry entry;
+            entry.word0 = lower[i].value;
+            if (entry.present) {
+                upper.push_back({ lower[i].addr + 0x4, 0 });
+            }
+        }
+        pmem.read32(&upper);
+    }
+
+    std::vector<uint32_t> table(count * 2, 0);
+    pmem::batch_t::const_iterator it = upper.begin();
+    for (uint64_t i = 0; i < count; ++i) {
+        struct page_entry entry;
+        entry.word0 = lower[i].value;
+        if (entry.present) {
+            entry.word1 = (it++)->value;
+            struct page_entry res = refresh_entry(ctx, entry);
+            table[i * 2] = res.word0;
+            table[i * 2 + 1] = res.word1;
+        }
+    }
+    shadow->write_block(0, table.data(), count * 0x8);
+}
+
+struct page_entry shadow_page_table::refresh_entry(context* ctx, const struct page_entry& entry) {
     return ctx->guest_to_host(entry);
 }
 
@@ -4,6 +4,7 @@
 #include <vector>
 #include <memory>
 #include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
 #include <memory>
 #include "page_table.h"
@@ -12,11 +13,19 @@ namespace a3 {
 class context;
 class page;
 
+// Guest page directory and page tables are barrier tracked after a full scan.
+// Guest writes to them are logged by mark_dirty, and the next refresh only
+// re-shadows the logged entries. A full rescan is done when the log overflows
+// or the page directory is changed.
 class shadow_page_table {
  public:
+    static const std::size_t kMAX_DIRTY_ENTRIES = 512;
+
     shadow_page_table(uint32_t channel_id);
     bool refresh(context* ctx, uint64_t page_directory_address, uint64_t page_limit);
     void refresh_page_directories(context* ctx, uint64_t address);
+    void mark_dirty(uint64_t address);
+    void untrack(context* ctx);
     void temporary_replace(context* ctx, uint64_t shadow);
     void set_low_size(uint32_t value);
     void set_high_size(uint32_t value);
@@ -29,10 +38,37 @@ class shadow_page_table {
     uint64_t page_directory_address() const { return page_directory_address_; }
     void allocate_shadow_address();
     uint64_t shadow_address() const { return phys() ? phys()->address() : 0; }
+    uint64_t vram_size() const {
+        return (phys() ? phys()->size() : 0) +
+            large_pages_pool_.size() * kLARGE_PAGE_COUNT * 0x8 +
+            small_pages_pool_.size() * kSMALL_PAGE_COUNT * 0x8;
+    }
 
  private:
-    struct page_directory refresh_directory(context* ctx, pmem::accessor* pmem, const struct page_directory& dir);
-    struct page_entry refresh_entry(context* ctx, pmem::accessor* pmem, const struct page_entry& entry);
+    // guest page directory entry and its tables
+    struct directory_state {
+        struct page_directory guest;
+        uint64_t large_address;
+        uint64_t small_address;
+        page* large_page;
+        page* small_page;
+    };
+
+    static const uint32_t kDIRECTORY_KEY = UINT32_MAX;
+
+    static uint32_t table_key(uint32_t index, bool large) {
+        return (index << 1) | (large ? 1 : 0);
+    }
+
+    void track(context* ctx, uint64_t address, uint64_t size, uint32_t key);
+    void untrack_directory(context* ctx, uint32_t index);
+    void refresh_dirty(context* ctx);
+    void refresh_dirty_directory(context* ctx, pmem::accessor* pmem, uint32_t index);
+    void refresh_dirty_entry(context* ctx, pmem::accessor* pmem, uint64_t address);
+    struct page_directory prepare_directory(context* ctx, uint32_t index, const struct page_directory& dir);
+    void refresh_tables(context* ctx, uint32_t index);
+    void refresh_table(context* ctx, uint64_t address, uint64_t count, page* shadow);
+    struct page_entry refresh_entry(context* ctx, const struct page_entry& entry);
     static uint64_t round_up(uint64_t x, uint64_t y) {
         return (((x) + (y - 1)) & ~(y - 1));
     }
@@ -55,12 +91,21 @@ class shadow_page_table {
     boost::ptr_vector<page> small_pages_pool_;
     std::size_t large_pages_pool_cursor_;
     std::size_t small_pages_pool_cursor_;
+
+    // write tracking
+    bool tracked_;
+    bool overflowed_;
+    uint64_t tracked_address_;
+    std::vector<directory_state> directories_;
+    boost::unordered_multimap<uint64_t, uint32_t> tables_;  // guest page => key
+    std::vector<uint64_t> dirty_;
 };
 
 inline page* shadow_page_table::allocate_large_page() {
     if (large_pages_pool_cursor_ == large_pages_pool_.size()) {
         page* ptr(new page(kLARGE_PAGE_COUNT * 0x8 / kPAGE_SIZE));
         large_pages_pool_.push_back(ptr);
+        ++large_pages_pool_cursor_;
         return ptr;
     }
     return &large_pages_pool_[large_pages_pool_cursor_++];
@@ -70,6 +115,7 @@ inline page* shadow_page_table::allocate_small_page() {
     if (small_pages_pool_cursor_ == small_pages_pool_.size()) {
         page* ptr = new page(kSMALL_PAGE_COUNT * 0x8 / kPAGE_SIZE);
         small_pages_pool_.push_back(ptr);
+        ++small_pages_pool_cursor_;
         return ptr;
     }
     return &small_pages_pool_[small_pages_pool_cursor_++];
@@ -0,0 +1,89 @@
+/*
+ * A3 Shadow Page Table Cache
+ *
+ * Copyright (c) 2012-2013 Yusuke Suzuki
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <cinttypes>
+#include "a3.h"
+#include "context.h"
+#include "shadow_page_table.h"
+#include "shadow_page_table_cache.h"
+namespace a3 {
+
+shadow_page_table_cache_t::shadow_page_table_cache_t(context* ctx, uint64_t budget)
+    : ctx_(ctx)
+    , budget_(budget)
+    , entries_()
+    , lru_()
+{
+}
+
+shadow_page_table* shadow_page_table_cache_t::acquire(uint64_t page_directory, uint32_t channel_id) {
+    entries_t::iterator it = entries_.find(page_directory);
+    if (it == entries_.end()) {
+        entry_t entry = { boost::make_shared<shadow_page_table>(channel_id), 0, lru_.end() };
+        it = entries_.insert(std::make_pair(page_directory, entry)).first;
+        A3_LOG("shadow cache miss 0x%" PRIX64 "\n", page_directory);
+        // make room for the new shadow
+        evict();
+    } else if (it->second.ref_count == 0) {
+        // reuse the cached shadow
+        lru_.erase(it->second.lru);
+        it->second.lru = lru_.end();
+        A3_LOG("shadow cache hit 0x%" PRIX64 "\n", page_directory);
+    }
+    ++it->second.ref_count;
+    return it->second.table.get();
+}
+
+void shadow_page_table_cache_t::release(uint64_t page_directory) {
+    entries_t::iterator it = entries_.find(page_directory);
+    ASSERT(it != entries_.end() && it->second.ref_count != 0);
+    if (--it->second.ref_count == 0) {
+        it->second.lru = lru_.insert(lru_.begin(), page_directory);
+        evict();
+    }
+}
+
+uint64_t shadow_page_table_cache_t::vram_size() const {
+    uint64_t size = 0;
+    for (const entries_t::value_type& pair : entries_) {
+        size += pair.second.table->vram_size();
+    }
+    return size;
+}
+
+void shadow_page_table_cache_t::evict() {
+    // least recently released first
+    uint64_t size = vram_size();
+    while (size > budget_ && !lru_.empty()) {
+        const uint64_t page_directory = lru_.back();
+        lru_.pop_back();
+        entries_t::iterator it = entries_.find(page_directory);
+        size -= it->second.table->vram_size();
+        it->second.table->untrack(ctx_);
+        entries_.erase(it);
+        A3_LOG("shadow cache evict 0x%" PRIX64 "\n", page_directory);
+    }
+}
+
+}  // namespace a3
+/* vim: set sw=4 ts=4 et tw=80 : */
@@ -0,0 +1,47 @@
+#ifndef A3_SHADOW_PAGE_TABLE_CACHE_H_
+#define A3_SHADOW_PAGE_TABLE_CACHE_H_
+#include <cstdint>
+#include <list>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/unordered_map.hpp>
+namespace a3 {
+class context;
+class shadow_page_table;
+
+// Per context cache of shadow page tables keyed by the guest page directory.
+// Channels bound to the same page directory share one shadow. All shadows,
+// in use or not, count against the VRAM budget. While it is exceeded,
+// released shadows are evicted in LRU order; in-use ones are never evicted,
+// so the budget can be overrun when they alone exceed it. A channel releases
+// its shadow when it is rebound, unbound by the guest, or torn down. Cached
+// shadows stay write tracked, so a reacquired one only re-shadows the entries
+// written since it was released, or is rescanned if the log overflowed.
+class shadow_page_table_cache_t : private boost::noncopyable {
+ public:
+    shadow_page_table_cache_t(context* ctx, uint64_t budget);
+    shadow_page_table* acquire(uint64_t page_directory, uint32_t channel_id);
+    void release(uint64_t page_directory);
+    uint64_t budget() const { return budget_; }
+
+ private:
+    struct entry_t {
+        boost::shared_ptr<shadow_page_table> table;
+        uint32_t ref_count;
+        std::list<uint64_t>::iterator lru;  // valid if ref_count is 0
+    };
+    typedef boost::unordered_map<uint64_t, entry_t> entries_t;
+
+    uint64_t vram_size() const;
+    void evict();
+
+    context* ctx_;
+    uint64_t budget_;
+    entries_t entries_;
+    std::list<uint64_t> lru_;  // released page directories, recent first
+};
+
+}  // namespace a3
+#endif  // A3_SHADOW_PAGE_TABLE_CACHE_H_
+/* vim: set sw=4 ts=4 et tw=80 : */
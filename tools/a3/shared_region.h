@@ -0,0 +1,72 @@
+#ifndef A3_SHARED_REGION_H_
+#define A3_SHARED_REGION_H_
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include "a3.h"
+namespace a3 {
+
+inline std::string shared_name(const char* format, uint32_t id) {
+    std::vector<char> name(200);
+    const int ret = std::snprintf(name.data(), name.size() - 1, format, id);
+    if (ret < 0) {
+        std::perror(nullptr);
+        std::exit(1);
+    }
+    name[ret] = '\0';
+    return std::string(name.data());
+}
+
+// T placed in named process shared memory. A3 (server) creates and constructs
+// it, and the device model (client) opens it.
+template<typename T>
+class shared_region_t : private boost::noncopyable {
+ public:
+    shared_region_t(bool server, const std::string& name)
+        : name_(name)
+        , server_(server)
+        , shm_()
+        , region_()
+        , object_()
+    {
+        if (server) {
+            interprocess::shared_memory_object::remove(name_.c_str());
+            shm_.reset(new interprocess::shared_memory_object(interprocess::create_only, name_.c_str(), interprocess::read_write));
+            shm_->truncate(sizeof(T));
+        } else {
+            shm_.reset(new interprocess::shared_memory_object(interprocess::open_only, name_.c_str(), interprocess::read_write));
+        }
+        region_.reset(new interprocess::mapped_region(*shm_, interprocess::read_write, 0, sizeof(T)));
+        if (server) {
+            object_ = new (region_->get_address()) T();
+        } else {
+            object_ = static_cast<T*>(region_->get_address());
+        }
+    }
+
+    ~shared_region_t() {
+        if (server_) {
+            interprocess::shared_memory_object::remove(name_.c_str());
+        }
+    }
+
+    T* get() const { return object_; }
+    T* operator->() const { return object_; }
+
+ private:
+    std::string name_;
+    bool server_;
+    boost::scoped_ptr<interprocess::shared_memory_object> shm_;
+    boost::scoped_ptr<interprocess::mapped_region> region_;
+    T* object_;
+};
+
+}  // namespace a3
+#endif  // A3_SHARED_REGION_H_
+/* vim: set sw=4 ts=4 et tw=80 : */
@@ -0,0 +1,146 @@
+/*
+ * A3 simulated device backend
+ *
+ * Copyright (c) 2012-2013 Yusuke Suzuki
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <chrono>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include "a3.h"
+#include "simulated_backend.h"
+namespace a3 {
+
+static void* map_anonymous(std::size_t size) {
+    // pages are populated on the first touch
+    void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (addr == MAP_FAILED) {
+        A3_FATAL(stderr, "cannot allocate simulated memory\n");
+        std::exit(1);
+    }
+    return addr;
+}
+
+simulated_backend_t::simulated_backend_t()
+    : bars_()
+    , vram_(nullptr)
+    , busy_until_(0)
+{
+}
+
+simulated_backend_t::~simulated_backend_t() {
+    for (std::size_t i = 0; i < bars_.size(); ++i) {
+        if (bars_[i].addr) {
+            munmap(bars_[i].addr, bars_[i].size);
+        }
+    }
+    if (vram_) {
+        munmap(vram_, kVRAM_SIZE);
+    }
+}
+
+bool simulated_backend_t::initialize(const bdf& bdf) {
+    const std::size_t sizes[] = { A3_BAR0_SIZE, A3_BAR1_TOTAL_SIZE, 0, A3_BAR3_TOTAL_SIZE, 0 };
+    for (std::size_t i = 0; i < bars_.size(); ++i) {
+        if (sizes[i]) {
+            bars_[i].addr = map_anonymous(sizes[i]);
+            bars_[i].base_addr = 0;
+            bars_[i].size = sizes[i];
+        }
+    }
+    vram_ = static_cast<uint8_t*>(map_anonymous(kVRAM_SIZE));
+    const uint32_t boot0 = kBOOT0;
+    std::memcpy(bars_[0].addr, &boot0, sizeof(uint32_t));
+    A3_LOG("simulated NVC0 with %" PRIu64 " MB VRAM\n", kVRAM_SIZE >> 20);
+    return true;
+}
+
+int64_t simulated_backend_t::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t simulated_backend_t::reg32(uint32_t offset) const {
+    uint32_t value;
+    std::memcpy(&value, static_cast<uint8_t*>(bars_[0].addr) + offset, sizeof(uint32_t));
+    return value;
+}
+
+uint8_t* simulated_backend_t::resolve(int bar, uint32_t offset, std::size_t size) {
+    if (bar == 0 && kPRAMIN_BASE <= offset && offset < (kPRAMIN_BASE + kPRAMIN_SIZE)) {
+        const uint64_t addr = (static_cast<uint64_t>(reg32(0x1700)) << 16) + (offset - kPRAMIN_BASE);
+        if (addr + size > kVRAM_SIZE) {
+            return nullptr;
+        }
+        return vram_ + addr;
+    }
+    if (!bars_[bar].addr || offset + size > bars_[bar].size) {
+        return nullptr;
+    }
+    return static_cast<uint8_t*>(bars_[bar].addr) + offset;
+}
+
+uint32_t simulated_backend_t::read(int bar, uint32_t offset, std::size_t size) {
+    const uint8_t* ptr = resolve(bar, offset, size);
+    if (!ptr) {
+        A3_LOG("simulated read out of range BAR%d 0x%" PRIx32 "\n", bar, offset);
+        return 0xffffffff;
+    }
+    uint32_t value = 0;
+    std::memcpy(&value, ptr, size);
+    if (bar == 0) {
+        switch (offset) {
+        case 0x070000:
+            // flush is done
+            return value & ~0x00000002;
+        case 0x100c80:
+            // TLB flush queue has space, and flush is done
+            return value | 0x00ff8000;
+        case 0x400700:
+            return now() < busy_until_.load(std::memory_order_relaxed) ? 0x1 : 0x0;
+        }
+    }
+    return value;
+}
+
+void simulated_backend_t::write(int bar, uint32_t offset, uint32_t val, std::size_t size) {
+    uint8_t* ptr = resolve(bar, offset, size);
+    if (!ptr) {
+        A3_LOG("simulated write out of range BAR%d 0x%" PRIx32 "\n", bar, offset);
+        return;
+    }
+    std::memcpy(ptr, &val, size);
+    if (bar == 0 && offset == 0x002274) {
+        // submitted channels keep PGRAPH busy for a while
+        busy_until_.store(now() + kPLAYLIST_BUSY_NS, std::memory_order_relaxed);
+    }
+}
+
+void* simulated_backend_t::map_aperture(uint64_t offset, uint64_t vram, std::size_t size) {
+    // BAR1 page tables are not walked, so expose VRAM itself
+    if (!vram_ || (vram + size) > kVRAM_SIZE) {
+        return nullptr;
+    }
+    return vram_ + vram;
+}
+
+}  // namespace a3
+/* vim: set sw=4 ts=4 et tw=80 : */
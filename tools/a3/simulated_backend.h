@@ -0,0 +1,46 @@
+#ifndef A3_SIMULATED_BACKEND_H_
+#define A3_SIMULATED_BACKEND_H_
+#include <array>
+#include <atomic>
+#include "device_backend.h"
+namespace a3 {
+
+// In-memory NVC0. BAR0 is a register file with the behavior A3 depends on,
+// VRAM is accessible through the PRAMIN window (0x1700 / 0x700000).
+// BAR1 and BAR3 are flat memory; their page tables are not walked.
+// The BAR1 aperture is VRAM itself.
+//
+//   0x002274  playlist submit, PGRAPH is busy for kPLAYLIST_BUSY_NS
+//   0x070000  PFIFO flush, completes immediately
+//   0x100c80  TLB flush status, always ready and done
+//   0x400700  PGRAPH status
+class simulated_backend_t : public device_backend_t {
+ public:
+    static const uint32_t kBOOT0 = 0x0c0000a1;  // NVC0
+    static const uint64_t kVRAM_SIZE = A3_HYPERVISOR_DEVICE_MEM_BASE + A3_HYPERVISOR_DEVICE_MEM_SIZE;
+    static const uint64_t kPRAMIN_BASE = 0x700000;
+    static const uint64_t kPRAMIN_SIZE = 0x100000;
+    static const int64_t kPLAYLIST_BUSY_NS = 20000;
+
+    simulated_backend_t();
+    virtual ~simulated_backend_t();
+    virtual bool simulated() const { return true; }
+    virtual bool initialize(const bdf& bdf);
+    virtual const device_bar_t& bar(int index) const { return bars_[index]; }
+    virtual uint32_t read(int bar, uint32_t offset, std::size_t size);
+    virtual void write(int bar, uint32_t offset, uint32_t val, std::size_t size);
+    virtual void* map_aperture(uint64_t offset, uint64_t vram, std::size_t size);
+
+ private:
+    uint8_t* resolve(int bar, uint32_t offset, std::size_t size);
+    uint32_t reg32(uint32_t offset) const;
+    static int64_t now();
+
+    std::array<device_bar_t, 5> bars_;
+    uint8_t* vram_;
+    std::atomic<int64_t> busy_until_;
+};
+
+}  // namespace a3
+#endif  // A3_SIMULATED_BACKEND_H_
+/* vim: set sw=4 ts=4 et tw=80 : */
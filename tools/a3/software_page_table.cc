@@ -30,7 +30,6 @@
 #include "pv_page.h"
 #include "context.h"
 #include "ignore_unused_variable_warning.h"
-#include "radix_tree.h"
 namespace a3 {
 
 software_page_table::software_page_table(uint32_t channel_id, bool para, uint64_t predefined_max)
@@ -113,9 +112,9 @@ void software_page_table::software_page_directory::refresh(context* ctx, pmem::a
             const uint64_t item = 0x8 * i;
             struct page_entry entry;
             if (page_entry::create(pmem, address + item, &entry)) {
-                (*large_entries_)[i].refresh(ctx, entry);
+                large_entries_->refresh(ctx, i, entry);
             } else {
-                (*large_entries_)[i].clear();
+                large_entries_->clear(i);
             }
         }
     } else {
@@ -133,9 +132,9 @@ void software_page_table::software_page_directory::refresh(context* ctx, pmem::a
             const uint64_t item = 0x8 * i;
             struct page_entry entry;
             if (page_entry::create(pmem, address + item, &entry)) {
-                (*small_entries_)[i].refresh(ctx, entry);
+                small_entries_->refresh(ctx, i, entry);
             } else {
-                (*small_entries_)[i].clear();
+                small_entries_->clear(i);
             }
         }
     } else {
@@ -156,12 +155,11 @@ uint64_t software_page_table::software_page_directory::resolve(uint64_t offset,
         const uint64_t index = offset / kSMALL_PAGE_SIZE;
         const uint64_t rest = offset % kSMALL_PAGE_SIZE;
         if (small_entries_->size() > index) {
-            const struct software_page_entry& entry = (*small_entries_)[index];
-            if (entry.present()) {
+            if (const struct software_page_entry* entry = small_entries_->find(index)) {
                 if (result) {
-                    *result = entry;
+                    *result = *entry;
                 }
-                const uint64_t address = entry.phys().address;
+                const uint64_t address = entry->phys().address;
                 return (address << 12) + rest;
             }
         }
@@ -171,12 +169,11 @@ uint64_t software_page_table::software_page_directory::resolve(uint64_t offset,
         const uint64_t index = offset / kLARGE_PAGE_SIZE;
         const uint64_t rest = offset % kLARGE_PAGE_SIZE;
         if (large_entries_->size() > index) {
-            const struct software_page_entry& entry = (*large_entries_)[index];
-            if (entry.present()) {
+            if (const struct software_page_entry* entry = large_entries_->find(index)) {
                 if (result) {
-                    *result = entry;
+                    *result = *entry;
                 }
-                const uint64_t address = entry.phys().address;
+                const uint64_t address = entry->phys().address;
                 return (address << 12) + rest;
             }
         }
@@ -190,11 +187,9 @@ void software_page_table::dump() const {
     for (software_page_directories::const_iterator it = directories_.begin(),
          iz = directories_.end(); it != iz; ++it, ++i) {
         const struct software_page_directory& dir = *it;
-        if (dir.large_entries()) {
-            std::size_t j = 0;
-            for (software_page_directory::software_page_entries::const_iterator jt = dir.large_entries()->begin(),
-                 jz = dir.large_entries()->end(); jt != jz; ++jt, ++j) {
-                if (jt->present()) {
+        if (const software_page_entries* entries = dir.large_entries()) {
+            for (std::size_t j = 0, jz = entries->size(); j < jz; ++j) {
+                if (const software_page_entry* jt = entries->find(j)) {
                     const uint64_t address = jt->phys().address;
                     ignore_unused_variable_warning(address);
                     A3_LOG("  PTE 0x%" PRIX64 " - 0x%" PRIX64 " => 0x%" PRIX64 " - 0x%" PRIX64 " [%s] type [%d]\n",
@@ -208,11 +203,9 @@ void software_page_table::dump() const {
             }
         }
 
-        if (dir.small_entries()) {
-            std::size_t j = 0;
-            for (software_page_directory::software_page_entries::const_iterator jt = dir.small_entries()->begin(),
-                 jz = dir.small_entries()->end(); jt != jz; ++jt, ++j) {
-                if (jt->present()) {
+        if (const software_page_entries* entries = dir.small_entries()) {
+            for (std::size_t j = 0, jz = entries->size(); j < jz; ++j) {
+                if (const software_page_entry* jt = entries->find(j)) {
                     const uint64_t address = jt->phys().address;
                     ignore_unused_variable_warning(address);
                     A3_LOG("  PTE 0x%" PRIX64 " - 0x%" PRIX64 " => 0x%" PRIX64 " - 0x%" PRIX64 " [%s] type [%d]\n",
@@ -235,12 +228,12 @@ void software_page_table::software_page_directory::pv_reflect(context* ctx, bool
         if (!large_entries()) {
             large_entries_.reset(new software_page_entries(kLARGE_PAGE_COUNT));
         }
-        (*large_entries_)[index].refresh(ctx, entry);
+        large_entries_->refresh(ctx, index, entry);
     } else {
         if (!small_entries()) {
             small_entries_.reset(new software_page_entries(kSMALL_PAGE_COUNT));
         }
-        (*small_entries_)[index].refresh(ctx, entry);
+        small_entries_->refresh(ctx, index, entry);
     }
 }
 
@@ -260,9 +253,9 @@ void software_page_table::software_page_directory::pv_scan(context* ctx, bool bi
             const uint64_t item = 0x8 * i;
             struct page_entry entry;
             if (page_entry::create(pgt, item, &entry)) {
-                (*large_entries_)[i].assign(entry);
+                large_entries_->assign(i, entry);
             } else {
-                (*large_entries_)[i].clear();
+                large_entries_->clear(i);
             }
         }
     } else {
@@ -275,9 +268,9 @@ void software_page_table::software_page_directory::pv_scan(context* ctx, bool bi
             const uint64_t item = 0x8 * i;
             struct page_entry entry;
             if (page_entry::create(pgt, item, &entry)) {
-                (*small_entries_)[i].assign(entry);
+                small_entries_->assign(i, entry);
             } else {
-                (*small_entries_)[i].clear();
+                small_entries_->clear(i);
             }
         }
     }
@@ -288,6 +281,44 @@ void software_page_table::pv_scan(context* ctx, uint32_t d, bool big, pv_page* p
     dir.pv_scan(ctx, big, pgt, predefined_max_);
 }
 
+void software_page_entries::refresh(context* ctx, std::size_t index, const struct page_entry& entry) {
+    software_page_entry result;
+    result.refresh(ctx, entry);
+    assign(index, result.phys());
+}
+
+void software_page_entries::assign(std::size_t index, const struct page_entry& entry) {
+    ASSERT(index < size());
+    if (!entry.present) {
+        clear(index);
+        return;
+    }
+    std::unique_ptr<leaf_t>& leaf = leaves_[index / kLEAF_SIZE];
+    if (!leaf) {
+        leaf.reset(new leaf_t());
+    }
+    software_page_entry& target = leaf->entries[index % kLEAF_SIZE];
+    if (!target.present()) {
+        ++leaf->present;
+    }
+    target.assign(entry);
+}
+
+void software_page_entries::clear(std::size_t index) {
+    ASSERT(index < size());
+    std::unique_ptr<leaf_t>& leaf = leaves_[index / kLEAF_SIZE];
+    if (!leaf) {
+        return;
+    }
+    software_page_entry& target = leaf->entries[index % kLEAF_SIZE];
+    if (target.present()) {
+        target.clear();
+        if (--leaf->present == 0) {
+            leaf.reset();
+        }
+    }
+}
+
 void software_page_entry::refresh(context* ctx, const struct page_entry& entry) {
     phys_ = ctx->guest_to_host(entry);
 }
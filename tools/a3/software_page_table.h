@@ -27,12 +27,50 @@ class software_page_entry {
     struct page_entry phys_;
 };
 
+// Sparse entries of a page table. Entries are held in leaves of kLEAF_SIZE
+// entries, allocated when the first present entry is assigned and released
+// when the last one is cleared, so a mostly unmapped table costs only its
+// leaf pointers. Lookup is two indexings.
+class software_page_entries {
+ public:
+    static const std::size_t kLEAF_SIZE = 64;
+
+    explicit software_page_entries(std::size_t count)
+        : count_(count)
+        , leaves_((count + kLEAF_SIZE - 1) / kLEAF_SIZE)
+    {
+    }
+
+    std::size_t size() const { return count_; }
+
+    // nullptr if the entry is not present
+    const software_page_entry* find(std::size_t index) const {
+        const leaf_t* leaf = leaves_[index / kLEAF_SIZE].get();
+        if (!leaf) {
+            return nullptr;
+        }
+        const software_page_entry& entry = leaf->entries[index % kLEAF_SIZE];
+        return entry.present() ? &entry : nullptr;
+    }
+
+    void refresh(context* ctx, std::size_t index, const struct page_entry& entry);
+    void assign(std::size_t index, const struct page_entry& entry);
+    void clear(std::size_t index);
+
+ private:
+    struct leaf_t {
+        std::size_t present;
+        software_page_entry entries[kLEAF_SIZE];
+    };
+
+    std::size_t count_;
+    std::vector<std::unique_ptr<leaf_t>> leaves_;
+};
+
 class software_page_table {
  private:
     class software_page_directory {
      public:
-        typedef std::vector<software_page_entry> software_page_entries;
-
         void refresh(context* ctx, pmem::accessor* pmem, const struct page_directory& dir, std::size_t remain);
         uint64_t resolve(uint64_t offset, struct software_page_entry* result);
         const software_page_entries* large_entries() const { return large_entries_.get(); }
@@ -0,0 +1,82 @@
+#ifndef A3_SOFTWARE_TLB_H_
+#define A3_SOFTWARE_TLB_H_
+#include <cstdint>
+#include <array>
+#include <boost/noncopyable.hpp>
+namespace a3 {
+
+// Direct mapped cache of BAR virtual page => guest physical page and whether
+// the page is a barrier, in front of the software page table resolve.
+//
+// Owners call invalidate() when the page table changes (TLB flush,
+// pv_reflect). Barrier map / unmap are caught by passing the barrier table
+// generation to lookup and insert. Entries are tagged with the TLB
+// generation, so invalidation is a single increment.
+class software_tlb_t : private boost::noncopyable {
+ public:
+    static const uint64_t kPAGE_BITS = 12;
+    static const uint64_t kPAGE_SIZE = 1ULL << kPAGE_BITS;
+    static const std::size_t kENTRIES = 64;
+
+    software_tlb_t()
+        : entries_()
+        , generation_(1)
+        , barrier_generation_(0)
+    {
+    }
+
+    bool lookup(uint32_t vaddr, uint64_t barrier_generation, uint64_t* gphys, bool* barrier) {
+        if (barrier_generation != barrier_generation_) {
+            barrier_generation_ = barrier_generation;
+            invalidate();
+            return false;
+        }
+        const uint64_t page = vaddr >> kPAGE_BITS;
+        const entry_t& entry = entries_[page % kENTRIES];
+        if (entry.tag != tag(page)) {
+            return false;
+        }
+        *gphys = entry.gphys + (vaddr & (kPAGE_SIZE - 1));
+        *barrier = entry.barrier;
+        return true;
+    }
+
+    void insert(uint32_t vaddr, uint64_t barrier_generation, uint64_t gphys, bool barrier) {
+        if (barrier_generation != barrier_generation_) {
+            barrier_generation_ = barrier_generation;
+            invalidate();
+        }
+        const uint64_t page = vaddr >> kPAGE_BITS;
+        entry_t& entry = entries_[page % kENTRIES];
+        entry.tag = tag(page);
+        entry.gphys = gphys & ~(kPAGE_SIZE - 1);
+        entry.barrier = barrier;
+    }
+
+    void invalidate() {
+        if (++generation_ == (1ULL << 32)) {
+            // tags of the wrapped generation may remain
+            entries_.fill(entry_t());
+            generation_ = 1;
+        }
+    }
+
+ private:
+    struct entry_t {
+        uint64_t tag;  // generation << 32 | virtual page, 0 if empty
+        uint64_t gphys;
+        bool barrier;
+    };
+
+    uint64_t tag(uint64_t page) const {
+        return (generation_ << 32) | page;
+    }
+
+    std::array<entry_t, kENTRIES> entries_;
+    uint64_t generation_;
+    uint64_t barrier_generation_;
+};
+
+}  // namespace a3
+#endif  // A3_SOFTWARE_TLB_H_
+/* vim: set sw=4 ts=4 et tw=80 : */
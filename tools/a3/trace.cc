@@ -0,0 +1,236 @@
+/*
+ * A3 tracing
+ *
+ * Copyright (c) 2012-2014 Yusuke Suzuki
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <cstdio>
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <boost/format.hpp>
+#include <boost/thread.hpp>
+#include <boost/algorithm/string.hpp>
+#include "a3.h"
+#include "trace.h"
+#include "utility.h"
+namespace a3 {
+namespace trace {
+
+std::atomic<uint32_t> g_categories(0);
+std::atomic<uint32_t> g_level(LEVEL_OFF);
+
+namespace {
+
+// single producer (owner thread) / single consumer (drain thread)
+class thread_buffer_t {
+ public:
+    static const uint32_t kSIZE = 1 << 14;
+    static const uint32_t kMASK = kSIZE - 1;
+
+    thread_buffer_t()
+        : head_(0)
+        , tail_(0)
+        , dropped_(0)
+        , records_(new record_t[kSIZE])
+    {
+    }
+
+    void push(const record_t& record) {
+        const uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == kSIZE) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        records_[tail & kMASK] = record;
+        tail_.store(tail + 1, std::memory_order_release);
+    }
+
+    std::size_t drain(std::FILE* file) {
+        const uint32_t head = head_.load(std::memory_order_relaxed);
+        const uint32_t tail = tail_.load(std::memory_order_acquire);
+        for (uint32_t i = head; i != tail; ++i) {
+            std::fwrite(&records_[i & kMASK], sizeof(record_t), 1, file);
+        }
+        head_.store(tail, std::memory_order_release);
+        return tail - head;
+    }
+
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+ private:
+    std::atomic<uint32_t> head_;
+    std::atomic<uint32_t> tail_;
+    std::atomic<uint64_t> dropped_;
+    std::unique_ptr<record_t[]> records_;
+};
+
+class drainer_t {
+ public:
+    static const int kINTERVAL_MS = 10;
+
+    drainer_t()
+        : mutex_()
+        , buffers_()
+        , file_(nullptr)
+        , thread_()
+        , dropped_(0)
+    {
+    }
+
+    bool open(const std::string& path) {
+        boost::mutex::scoped_lock lock(mutex_);
+        if (file_) {
+            return true;
+        }
+        file_ = std::fopen(path.c_str(), "wb");
+        if (!file_) {
+            return false;
+        }
+        const file_header_t header = { kMAGIC, sizeof(record_t) };
+        std::fwrite(&header, sizeof(header), 1, file_);
+        thread_.reset(new boost::thread(&drainer_t::main, this));
+        return true;
+    }
+
+    bool opened() {
+        boost::mutex::scoped_lock lock(mutex_);
+        return file_ != nullptr;
+    }
+
+    // thread buffers are never released, since the drain thread may touch
+    // them after their owner threads exit
+    thread_buffer_t* allocate() {
+        boost::mutex::scoped_lock lock(mutex_);
+        buffers_.push_back(new thread_buffer_t());
+        return buffers_.back();
+    }
+
+ private:
+    void main() {
+        for (;;) {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(kINTERVAL_MS));
+            boost::mutex::scoped_lock lock(mutex_);
+            std::size_t count = 0;
+            uint64_t dropped = 0;
+            for (thread_buffer_t* buffer : buffers_) {
+                count += buffer->drain(file_);
+                dropped += buffer->dropped();
+            }
+            if (dropped != dropped_) {
+                // reported in the trace itself, A3_LOG is off in release builds
+                const uint32_t lost = static_cast<uint32_t>(std::min<uint64_t>(dropped - dropped_, UINT32_MAX));
+                const record_t record = { now(), 0, 0, 0, lost, CATEGORY_DROPPED, 0, 0 };
+                std::fwrite(&record, sizeof(record_t), 1, file_);
+                dropped_ = dropped;
+                ++count;
+            }
+            if (count) {
+                std::fflush(file_);
+            }
+        }
+    }
+
+    boost::mutex mutex_;
+    std::vector<thread_buffer_t*> buffers_;
+    std::FILE* file_;
+    std::unique_ptr<boost::thread> thread_;
+    uint64_t dropped_;  // already reported
+};
+
+const int drainer_t::kINTERVAL_MS;
+
+drainer_t* drainer() {
+    static drainer_t instance;
+    return &instance;
+}
+
+__thread thread_buffer_t* t_buffer = nullptr;
+
+}  // namespace anonymous
+
+bool open(const std::string& path) {
+    return drainer()->open(path);
+}
+
+bool configure(uint32_t categories, level_t level) {
+    // records would fill the rings and be dropped without the drain thread
+    if (!drainer()->opened()) {
+        return false;
+    }
+    g_categories.store(categories, std::memory_order_relaxed);
+    g_level.store(level, std::memory_order_relaxed);
+    return true;
+}
+
+uint32_t parse_categories(const std::string& list) {
+    std::vector<std::string> names;
+    boost::split(names, list, boost::is_any_of(","));
+    uint32_t categories = 0;
+    for (const std::string& name : names) {
+        if (name == "all") {
+            categories |= CATEGORY_ALL;
+        }
+#define V(NAME, lower, bit) if (name == #lower) { categories |= CATEGORY_##NAME; }
+        A3_TRACE_CATEGORIES(V)
+#undef V
+    }
+    return categories;
+}
+
+void emit(const record_t& record) {
+    if (!t_buffer) {
+        t_buffer = drainer()->allocate();
+    }
+    t_buffer->push(record);
+}
+
+std::string format(const record_t& record) {
+    const uint64_t address = (static_cast<uint64_t>(record.bar) << 32) | record.offset;
+    switch (record.category) {
+    case CATEGORY_DROPPED:
+        return boost::str(boost::format("[DROPPED] %u records") % record.value);
+
+    case CATEGORY_COMMAND: {
+            command cmd = { };
+            cmd.type = record.type;
+            cmd.offset = record.offset;
+            cmd.value = record.value;
+            cmd.u8[0] = record.bar;
+            return examine(cmd, record.value);
+        }
+
+    case CATEGORY_BARRIER:
+        return boost::str(boost::format("[BARRIER] 0x%010X <= 0x%08X") % address % record.value);
+
+    case CATEGORY_SHADOW:
+        if (record.type == EVENT_SHADOW_DIRTY) {
+            return boost::str(boost::format("[SHADOW] dirty pd 0x%010X entries %u") % address % record.value);
+        }
+        return boost::str(boost::format("[SHADOW] rescan pd 0x%010X channel %u") % address % record.value);
+
+    case CATEGORY_SCHEDULER:
+        return "[SCHEDULER] completion";
+    }
+    return boost::str(boost::format("[%04X] %u 0x%08X 0x%08X") % record.category % static_cast<unsigned>(record.type) % record.offset % record.value);
+}
+
+} }  // namespace a3::trace
+/* vim: set sw=4 ts=4 et tw=80 : */
@@ -0,0 +1,130 @@
+#ifndef A3_TRACE_H_
+#define A3_TRACE_H_
+#include <cstdint>
+#include <cstdio>
+#include <atomic>
+#include <string>
+#include <time.h>
+#include "a3.h"
+namespace a3 {
+namespace trace {
+
+// Binary tracing. Records are fixed size and are written into the per-thread
+// ring without any lock, and drained to the file by the background thread.
+// When the ring is full, records are dropped and counted, and the drain thread
+// writes the count as a CATEGORY_DROPPED record.
+// Use a3-trace to decode the file into the human readable form.
+
+#define A3_TRACE_CATEGORIES(V)\
+    V(COMMAND, command, 0)\
+    V(BARRIER, barrier, 1)\
+    V(SHADOW, shadow, 2)\
+    V(SCHEDULER, scheduler, 3)
+
+enum category_t {
+#define V(NAME, name, bit) CATEGORY_##NAME = 1 << bit,
+    A3_TRACE_CATEGORIES(V)
+#undef V
+    CATEGORY_DROPPED = 0,  // value: records lost since the last one
+    CATEGORY_ALL = 0xffff
+};
+
+enum level_t {
+    LEVEL_OFF = 0,
+    LEVEL_INFO = 1,
+    LEVEL_DEBUG = 2
+};
+
+// record type of the non command categories
+enum event_t {
+    EVENT_BARRIER_WRITE = 0,         // INFO: address <= value
+    EVENT_SHADOW_RESCAN = 0,         // INFO: page directory, channel id
+    EVENT_SHADOW_DIRTY = 1,          // DEBUG: page directory, entries
+    EVENT_SCHEDULER_COMPLETION = 0   // INFO: waited until the GPU goes idle
+};
+
+struct record_t {
+    uint64_t timestamp;  // ns, CLOCK_MONOTONIC
+    uint64_t latency;    // ns
+    uint32_t context;
+    uint32_t offset;
+    uint32_t value;
+    uint16_t category;
+    uint8_t  type;
+    uint8_t  bar;        // address bits 32-39 for non command records
+};
+
+static_assert(sizeof(record_t) == 32, "trace record should be 32 bytes");
+
+static const uint32_t kMAGIC = 0x45435241;  // "ARCE"
+
+struct file_header_t {
+    uint32_t magic;
+    uint32_t record_size;
+};
+
+extern std::atomic<uint32_t> g_categories;
+extern std::atomic<uint32_t> g_level;
+
+inline bool enabled(category_t category, level_t level) {
+    return (g_categories.load(std::memory_order_relaxed) & category) &&
+        level <= static_cast<level_t>(g_level.load(std::memory_order_relaxed));
+}
+
+inline uint64_t now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+// starts the drain thread writing to path
+bool open(const std::string& path);
+// fails until the trace file is opened
+bool configure(uint32_t categories, level_t level);
+uint32_t parse_categories(const std::string& list);
+void emit(const record_t& record);
+
+// start is 0 when tracing was enabled while the command was handled
+inline void record_command(uint32_t context, const a3::command& cmd, uint32_t value, uint64_t start) {
+    if (!enabled(CATEGORY_COMMAND, LEVEL_INFO)) {
+        return;
+    }
+    const uint64_t end = now();
+    const record_t record = {
+        end,
+        start ? end - start : 0,
+        context,
+        cmd.offset,
+        (cmd.type == a3::command::TYPE_READ) ? value : cmd.value,
+        CATEGORY_COMMAND,
+        static_cast<uint8_t>(cmd.type),
+        cmd.u8[0]
+    };
+    emit(record);
+}
+
+// start is 0 when the latency is not measured
+inline void record_event(category_t category, level_t level, event_t type, uint32_t context, uint64_t address, uint32_t value, uint64_t start) {
+    if (!enabled(category, level)) {
+        return;
+    }
+    const uint64_t end = now();
+    const record_t record = {
+        end,
+        start ? end - start : 0,
+        context,
+        static_cast<uint32_t>(address),
+        value,
+        static_cast<uint16_t>(category),
+        static_cast<uint8_t>(type),
+        static_cast<uint8_t>(address >> 32)
+    };
+    emit(record);
+}
+
+// commands are in the same form as examine()
+std::string format(const record_t& record);
+
+} }  // namespace a3::trace
+#endif  // A3_TRACE_H_
+/* vim: set sw=4 ts=4 et tw=80 : */
@@ -0,0 +1,80 @@
+/*
+ * A3 trace decoder
+ *
+ * Copyright (c) 2012-2013 Yusuke Suzuki
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <cstdio>
+#include <string>
+#include "a3.h"
+#include "cmdline.h"
+#include "trace.h"
+
+int main(int argc, char** argv) {
+    namespace c = a3;
+    c::cmdline::Parser cmd("a3-trace");
+
+    cmd.Add("help", "help", 'h', "print this message");
+    cmd.Add("verbose", "verbose", 'v', "print timestamp, context and latency");
+    cmd.set_footer("trace_file");
+
+    if (!cmd.Parse(argc, argv)) {
+        std::fprintf(stderr, "%s\n%s", cmd.error().c_str(), cmd.usage().c_str());
+        return 1;
+    }
+
+    if (cmd.Exist("help") || cmd.rest().empty()) {
+        std::fputs(cmd.usage().c_str(), stdout);
+        return 1;
+    }
+
+    std::FILE* file = std::fopen(cmd.rest().front().c_str(), "rb");
+    if (!file) {
+        std::perror(nullptr);
+        return 1;
+    }
+
+    c::trace::file_header_t header;
+    if (std::fread(&header, sizeof(header), 1, file) != 1 ||
+        header.magic != c::trace::kMAGIC ||
+        header.record_size != sizeof(c::trace::record_t)) {
+        std::fprintf(stderr, "invalid trace file\n");
+        std::fclose(file);
+        return 1;
+    }
+
+    const bool verbose = cmd.Exist("verbose");
+    unsigned long long count = 0;
+    c::trace::record_t record;
+    while (std::fread(&record, sizeof(record), 1, file) == 1) {
+        const std::string str = c::trace::format(record);
+        if (str.empty()) {
+            continue;
+        }
+        if (verbose) {
+            std::printf("[A3][%08llu] I %s ctx=%u ts=%llu latency=%lluns\n", count++, str.c_str(), record.context, static_cast<unsigned long long>(record.timestamp), static_cast<unsigned long long>(record.latency));
+        } else {
+            std::printf("[A3][%08llu] I %s\n", count++, str.c_str());
+        }
+    }
+    std::fclose(file);
+    return 0;
+}
+/* vim: set sw=4 ts=4 et tw=80 : */
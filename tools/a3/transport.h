@@ -0,0 +1,149 @@
+#ifndef A3_TRANSPORT_H_
+#define A3_TRANSPORT_H_
+#include <string>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/interprocess/ipc/message_queue.hpp>
+#include "a3.h"
+#include "ring.h"
+#include "shared_region.h"
+namespace a3 {
+
+// Transport of MMIO commands between the device model (client) and A3
+// (server). Requests flow client -> server, responses flow server -> client.
+class transport_t : private boost::noncopyable {
+ public:
+    enum type_t {
+        TRANSPORT_MESSAGE_QUEUE = 0,
+        TRANSPORT_RING = 1
+    };
+
+    virtual ~transport_t() { }
+    virtual type_t type() const = 0;
+
+    // client side
+    virtual void send_request(const command& cmd) = 0;
+    virtual void receive_response(command* cmd) = 0;
+
+    // server side
+    virtual void receive_request(command* cmd) = 0;
+    virtual void send_response(const command& cmd) = 0;
+
+    // server creates the shared objects, and client opens them
+    static transport_t* create(type_t type, uint32_t id);
+    static transport_t* open(type_t type, uint32_t id);
+
+    static const char* name(type_t type) {
+        return type == TRANSPORT_RING ? "ring" : "mq";
+    }
+};
+
+class message_queue_transport_t : public transport_t {
+ public:
+    static const std::size_t kQUEUE_SIZE = 0x100000;
+
+    message_queue_transport_t(bool server, uint32_t id)
+        : req_queue_()
+        , res_queue_()
+    {
+        const std::string req = shared_name("a3_shared_req_queue_%u", id);
+        const std::string res = shared_name("a3_shared_res_queue_%u", id);
+        if (server) {
+            // delete queue & construct new queue
+            interprocess::message_queue::remove(req.c_str());
+            req_queue_.reset(new interprocess::message_queue(interprocess::create_only, req.c_str(), kQUEUE_SIZE, sizeof(command)));
+            interprocess::message_queue::remove(res.c_str());
+            res_queue_.reset(new interprocess::message_queue(interprocess::create_only, res.c_str(), kQUEUE_SIZE, sizeof(command)));
+        } else {
+            req_queue_.reset(new interprocess::message_queue(interprocess::open_only, req.c_str()));
+            res_queue_.reset(new interprocess::message_queue(interprocess::open_only, res.c_str()));
+        }
+    }
+
+    virtual type_t type() const { return TRANSPORT_MESSAGE_QUEUE; }
+
+    virtual void send_request(const command& cmd) {
+        req_queue_->send(&cmd, sizeof(command), 0);
+    }
+
+    virtual void receive_response(command* cmd) {
+        receive(res_queue_.get(), cmd);
+    }
+
+    virtual void receive_request(command* cmd) {
+        receive(req_queue_.get(), cmd);
+    }
+
+    virtual void send_response(const command& cmd) {
+        res_queue_->send(&cmd, sizeof(command), 0);
+    }
+
+ private:
+    static void receive(interprocess::message_queue* queue, command* cmd) {
+        unsigned int priority;
+        std::size_t size;
+        queue->receive(cmd, sizeof(command), size, priority);
+    }
+
+    boost::scoped_ptr<interprocess::message_queue> req_queue_;
+    boost::scoped_ptr<interprocess::message_queue> res_queue_;
+};
+
+class ring_transport_t : public transport_t {
+ public:
+    static const std::size_t kRING_SIZE = 0x10000;
+    typedef ring_t<command, kRING_SIZE> ring_type;
+
+    struct area_t {
+        ring_type request;
+        ring_type response;
+    };
+
+    ring_transport_t(bool server, uint32_t id)
+        : area_(server, shared_name("a3_shared_ring_%u", id))
+        , request_spinner_()
+        , response_spinner_()
+    {
+    }
+
+    virtual type_t type() const { return TRANSPORT_RING; }
+
+    virtual void send_request(const command& cmd) {
+        area_->request.push(cmd, &request_spinner_);
+    }
+
+    virtual void receive_response(command* cmd) {
+        area_->response.pop(cmd, &response_spinner_);
+    }
+
+    virtual void receive_request(command* cmd) {
+        area_->request.pop(cmd, &request_spinner_);
+    }
+
+    virtual void send_response(const command& cmd) {
+        area_->response.push(cmd, &response_spinner_);
+    }
+
+ private:
+    shared_region_t<area_t> area_;
+    ring_detail::spinner_t request_spinner_;
+    ring_detail::spinner_t response_spinner_;
+};
+
+inline transport_t* transport_t::create(type_t type, uint32_t id) {
+    if (type == TRANSPORT_RING) {
+        return new ring_transport_t(true, id);
+    }
+    return new message_queue_transport_t(true, id);
+}
+
+inline transport_t* transport_t::open(type_t type, uint32_t id) {
+    if (type == TRANSPORT_RING) {
+        return new ring_transport_t(false, id);
+    }
+    return new message_queue_transport_t(false, id);
+}
+
+}  // namespace a3
+#endif  // A3_TRANSPORT_H_
+/* vim: set sw=4 ts=4 et tw=80 : */
@@ -23,7 +23,6 @@
  */
 #include "a3.h"
 #include "utility.h"
-#include <cstdio>
 #include <string>
 #include <boost/format.hpp>
 namespace a3 {
@@ -37,13 +36,5 @@ std::string examine(command cmd, uint32_t value) {
     return boost::str(boost::format("[%c] BAR%d 0x%08X 0x%08X") % RW % cmd.bar() % cmd.offset % v);
 }
 
-void inspect(command cmd, uint32_t value) {
-    const std::string str = examine(cmd, value);
-    if (str.empty()) {
-        return;
-    }
-    A3_RAW_FPRINTF(stdout, "I %s\n", str.c_str());
-}
-
 }  // namespace a3
 /* vim: set sw=4 ts=4 et tw=80 : */
@@ -4,8 +4,7 @@
 #include "a3.h"
 namespace a3 {
 
-std::string examine(command cmd);
-void inspect(command cmd, uint32_t value);
+std::string examine(command cmd, uint32_t value);
 
 }  // namespace a3
 #endif  // A3_UTILITY_H_
@@ -27,7 +27,9 @@ namespace a3 {
 vram_manager_t::vram_manager_t(uint64_t mem, uint64_t size)
     : mem_(mem)
     , size_(size)
-    , cursor_(0) {
+    , cursor_(0)
+    , free_list_()
+    , mutex_(LOCK_RANK_VRAM) {
 }
 
 // K&R malloc
@@ -46,41 +48,46 @@ bool vram_manager_t::more(std::size_t n) {
 }
 
 vram_t* vram_manager_t::malloc(std::size_t n) {
-    do {
-        for (auto& entry : free_list_) {
-            if (entry.units_ >= n) {
-                if (entry.units_ == n) {
-                    free_list_.erase(free_list_t::s_iterator_to(entry));
-                    return &entry;
+    A3_SYNCHRONIZED(mutex_) {
+        do {
+            for (auto& entry : free_list_) {
+                if (entry.units_ >= n) {
+                    if (entry.units_ == n) {
+                        free_list_.erase(free_list_t::s_iterator_to(entry));
+                        return &entry;
+                    }
+                    entry.units_ -= n;
+                    return new vram_t(entry.address_ + entry.units_ * kPAGE_SIZE, n);
                 }
-                entry.units_ -= n;
-                return new vram_t(entry.address_ + entry.units_ * kPAGE_SIZE, n);
             }
-        }
-        if (!more(n)) {
-            std::abort();
-        }
-    } while (true);
+            if (!more(n)) {
+                std::abort();
+            }
+        } while (true);
+    }
+    return nullptr;  // make compiler happy
 }
 
 void vram_manager_t::free(vram_t* entry) {
-    const auto range = std::equal_range(free_list_.begin(), free_list_.end(), *entry, [](const vram_t& i, const vram_t& j) {
-        return i.address_ < j.address_;
-    });
-    auto& prev = range.first;
-    auto& next = range.second;
-    free_list_.insert(next, *entry);
-    if (next != free_list_.end() && (entry->address_ + entry->units_ * kPAGE_SIZE) == next->address_) {
-        // join current and next
-        entry->units_ += next->units_;
-        vram_t* del = &*next;
-        free_list_.erase(free_list_t::s_iterator_to(*del));
-        delete del;
-    }
-    if (prev != free_list_.end() && (prev->address_ + prev->units_ * kPAGE_SIZE) == entry->address_) {
-        prev->units_ += entry->units_;
-        free_list_.erase(free_list_t::s_iterator_to(*entry));
-        delete entry;
+    A3_SYNCHRONIZED(mutex_) {
+        const auto range = std::equal_range(free_list_.begin(), free_list_.end(), *entry, [](const vram_t& i, const vram_t& j) {
+            return i.address_ < j.address_;
+        });
+        auto& prev = range.first;
+        auto& next = range.second;
+        free_list_.insert(next, *entry);
+        if (next != free_list_.end() && (entry->address_ + entry->units_ * kPAGE_SIZE) == next->address_) {
+            // join current and next
+            entry->units_ += next->units_;
+            vram_t* del = &*next;
+            free_list_.erase(free_list_t::s_iterator_to(*del));
+            delete del;
+        }
+        if (prev != free_list_.end() && (prev->address_ + prev->units_ * kPAGE_SIZE) == entry->address_) {
+            prev->units_ += entry->units_;
+            free_list_.erase(free_list_t::s_iterator_to(*entry));
+            delete entry;
+        }
     }
 }
 
@@ -7,6 +7,7 @@
 #include <boost/intrusive/list.hpp>
 #include "a3.h"
 #include "page_table.h"
+#include "lock.h"
 namespace a3 {
 
 class vram_manager_t;
@@ -45,6 +46,7 @@ class vram_manager_t : private boost::noncopyable {
     uint64_t size_;
     uint64_t cursor_;
     free_list_t free_list_;
+    ranked_mutex_t mutex_;
 };
 
 }  // namespace a3
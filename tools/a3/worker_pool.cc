@@ -0,0 +1,119 @@
+/*
+ * A3 Worker Pool
+ *
+ * Copyright (c) 2012-2013 Yusuke Suzuki
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "a3.h"
+#include "lock.h"
+#include "worker_pool.h"
+namespace a3 {
+
+worker_pool_t::worker_pool_t(std::size_t workers)
+    : threads_()
+    , loop_mutex_()
+    , mutex_()
+    , wake_()
+    , done_()
+    , func_(nullptr)
+    , size_(0)
+    , next_(0)
+    , pending_(0)
+    , generation_(0)
+    , stop_(false)
+{
+    for (std::size_t i = 0; i < workers; ++i) {
+        threads_.emplace_back(new boost::thread(&worker_pool_t::run, this));
+    }
+}
+
+worker_pool_t::~worker_pool_t() {
+    A3_SYNCHRONIZED(mutex_) {
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& thread : threads_) {
+        thread->join();
+    }
+}
+
+void worker_pool_t::parallel_for(std::size_t n, const function_t& func) {
+    if (threads_.empty() || n <= 1) {
+        for (std::size_t i = 0; i < n; ++i) {
+            func(i);
+        }
+        return;
+    }
+
+    boost::unique_lock<boost::mutex> loop(loop_mutex_);
+    A3_SYNCHRONIZED(mutex_) {
+        func_ = &func;
+        size_ = n;
+        next_.store(0, std::memory_order_relaxed);
+        pending_ = threads_.size();
+        ++generation_;
+    }
+    wake_.notify_all();
+
+    drain();
+
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (pending_) {
+        done_.wait(lock);
+    }
+    func_ = nullptr;
+}
+
+void worker_pool_t::drain() {
+    for (std::size_t i = next_.fetch_add(1); i < size_; i = next_.fetch_add(1)) {
+        (*func_)(i);
+    }
+}
+
+void worker_pool_t::run() {
+    uint64_t generation = 0;
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (true) {
+        while (!stop_ && generation == generation_) {
+            wake_.wait(lock);
+        }
+        if (stop_) {
+            return;
+        }
+        generation = generation_;
+        lock.unlock();
+        drain();
+        // drain write combined stores of this core before the caller
+        // hands the results to the device
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        lock.lock();
+        if (--pending_ == 0) {
+            done_.notify_one();
+        }
+    }
+}
+
+worker_pool_t* shadow_workers() {
+    static worker_pool_t pool(flags::shadow_workers);
+    return &pool;
+}
+
+}  // namespace a3
+/* vim: set sw=4 ts=4 et tw=80 : */
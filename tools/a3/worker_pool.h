@@ -0,0 +1,47 @@
+#ifndef A3_WORKER_POOL_H_
+#define A3_WORKER_POOL_H_
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <boost/thread.hpp>
+#include <boost/noncopyable.hpp>
+namespace a3 {
+
+// Fixed set of threads running parallel loops. The calling thread joins the
+// loop as well, so a pool without threads runs it sequentially.
+class worker_pool_t : private boost::noncopyable {
+ public:
+    typedef std::function<void(std::size_t)> function_t;
+
+    explicit worker_pool_t(std::size_t workers);
+    ~worker_pool_t();
+    std::size_t size() const { return threads_.size(); }
+    // calls func(i) for i in [0, n) and returns after all calls are done.
+    // func must not take locks the caller holds
+    void parallel_for(std::size_t n, const function_t& func);
+
+ private:
+    void run();
+    void drain();
+
+    std::vector<std::unique_ptr<boost::thread>> threads_;
+    boost::mutex loop_mutex_;  // one loop at a time
+    boost::mutex mutex_;
+    boost::condition_variable wake_;
+    boost::condition_variable done_;
+    const function_t* func_;
+    std::size_t size_;
+    std::atomic<std::size_t> next_;
+    std::size_t pending_;
+    uint64_t generation_;
+    bool stop_;
+};
+
+// shared by shadow page table refreshes, flags::shadow_workers threads
+worker_pool_t* shadow_workers();
+
+}  // namespace a3
+#endif  // A3_WORKER_POOL_H_
+/* vim: set sw=4 ts=4 et tw=80 : */
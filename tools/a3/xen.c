@@ -21,6 +21,7 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
  */
+#include <errno.h>
 #include <libxl.h>
 #include "xen.h"
 
@@ -33,20 +34,83 @@ static xc_interface* libxl_ctx_xch(libxl_ctx* ctx) {
     return ((struct temp*)ctx)->xch;
 }
 
+// ctx is NULL when the device is simulated. There is no domain to map.
+
 int a3_xen_add_memory_mapping(libxl_ctx* ctx, int domid, unsigned long first_gfn, unsigned long first_mfn, unsigned long nr_mfns) {
+    if (!ctx) {
+        return 0;
+    }
     return xc_domain_memory_mapping(libxl_ctx_xch(ctx), domid, first_gfn, first_mfn, nr_mfns, DPCI_ADD_MAPPING);
 }
 
+// Reads go to the device and writes fault to the device model.
+// Fails on hypervisors without DPCI_ADD_MAPPING_RO.
+int a3_xen_add_memory_mapping_read_only(libxl_ctx* ctx, int domid, unsigned long first_gfn, unsigned long first_mfn, unsigned long nr_mfns) {
+    if (!ctx) {
+        return 0;
+    }
+    return xc_domain_memory_mapping(libxl_ctx_xch(ctx), domid, first_gfn, first_mfn, nr_mfns, DPCI_ADD_MAPPING_RO);
+}
+
 int a3_xen_remove_memory_mapping(libxl_ctx* ctx, int domid, unsigned long first_gfn, unsigned long first_mfn, unsigned long nr_mfns) {
+    if (!ctx) {
+        return 0;
+    }
     return xc_domain_memory_mapping(libxl_ctx_xch(ctx), domid, first_gfn, first_mfn, nr_mfns, DPCI_REMOVE_MAPPING);
 }
 
+// Applies the extents in order, A3_XEN_MEMORY_MAPPING_CHUNK per libxc call.
+// Extents applied before a failing one are kept, and done is set to the index
+// of the failing one. Returns 0 or -errno.
+#define A3_XEN_MEMORY_MAPPING_CHUNK 128
+int a3_xen_memory_mapping_batch(libxl_ctx* ctx, int domid, const a3_xen_memory_mapping_t* extents, unsigned long nr_extents, unsigned long* done) {
+    xen_domctl_memory_mapping_t batch[A3_XEN_MEMORY_MAPPING_CHUNK];
+    unsigned long i;
+    unsigned int applied;
+
+    *done = 0;
+    if (!ctx) {
+        *done = nr_extents;
+        return 0;
+    }
+
+    while (*done < nr_extents) {
+        unsigned int nr = A3_XEN_MEMORY_MAPPING_CHUNK;
+        if (nr_extents - *done < nr) {
+            nr = nr_extents - *done;
+        }
+        for (i = 0; i < nr; ++i) {
+            const a3_xen_memory_mapping_t* extent = &extents[*done + i];
+            batch[i].first_gfn = extent->first_gfn;
+            batch[i].first_mfn = extent->first_mfn;
+            batch[i].nr_mfns = extent->nr_mfns;
+            batch[i].add_mapping =
+                (extent->mapping == A3_XEN_MAPPED) ? DPCI_ADD_MAPPING :
+                (extent->mapping == A3_XEN_READ_ONLY) ? DPCI_ADD_MAPPING_RO : DPCI_REMOVE_MAPPING;
+            batch[i].padding = 0;
+        }
+        applied = 0;
+        if (xc_domain_memory_mapping_batch(libxl_ctx_xch(ctx), domid, nr, batch, &applied) != 0) {
+            *done += applied;
+            return errno ? -errno : -EINVAL;
+        }
+        *done += nr;
+    }
+    return 0;
+}
+
 void* a3_xen_map_foreign_range(libxl_ctx* ctx, int domid, int size, int prot, unsigned long mfn) {
+    if (!ctx) {
+        return NULL;
+    }
     return xc_map_foreign_range(libxl_ctx_xch(ctx), domid, size, prot, mfn);
 }
 
 unsigned long a3_xen_gfn_to_mfn(libxl_ctx* ctx, int domid, unsigned long gfn) {
     unsigned long mfn;
+    if (!ctx) {
+        return gfn;
+    }
     const int ret = xc_domain_gfn_to_mfn(libxl_ctx_xch(ctx), domid, gfn, &mfn);
     if (ret != 0) {
         return 0;
@@ -54,4 +118,77 @@ unsigned long a3_xen_gfn_to_mfn(libxl_ctx* ctx, int domid, unsigned long gfn) {
     return mfn;
 }
 
+// mfns[i] is 0 if gfns[i] is not mapped
+// Translates XEN_DOMCTL_GFN_TO_MFN_BATCH_MAX frames per hypercall. Falls back
+// to the single frame domctl when the hypervisor lacks the batched one.
+int a3_xen_gfn_to_mfn_batch(libxl_ctx* ctx, int domid, const unsigned long* gfns, unsigned long nr_gfns, unsigned long* mfns) {
+    xen_pfn_t batch[XEN_DOMCTL_GFN_TO_MFN_BATCH_MAX];
+    xen_pfn_t result[XEN_DOMCTL_GFN_TO_MFN_BATCH_MAX];
+    int errs[XEN_DOMCTL_GFN_TO_MFN_BATCH_MAX];
+    unsigned long done = 0;
+    unsigned long i;
+
+    if (!ctx) {
+        for (i = 0; i < nr_gfns; ++i) {
+            mfns[i] = gfns[i];
+        }
+        return 0;
+    }
+
+    while (done < nr_gfns) {
+        unsigned int nr = XEN_DOMCTL_GFN_TO_MFN_BATCH_MAX;
+        if (nr_gfns - done < nr) {
+            nr = nr_gfns - done;
+        }
+        for (i = 0; i < nr; ++i) {
+            batch[i] = gfns[done + i];
+        }
+        if (xc_domain_gfn_to_mfn_batch(libxl_ctx_xch(ctx), domid, nr, batch, result, errs, NULL) != 0) {
+            break;
+        }
+        for (i = 0; i < nr; ++i) {
+            mfns[done + i] = errs[i] ? 0 : result[i];
+        }
+        done += nr;
+    }
+
+    for (i = done; i < nr_gfns; ++i) {
+        mfns[i] = a3_xen_gfn_to_mfn(ctx, domid, gfns[i]);
+    }
+    return 0;
+}
+
+// Reads the p2m generation of the domain, which changes whenever its p2m
+// does. Returns -1 when the hypervisor lacks the batched domctl.
+int a3_xen_p2m_generation(libxl_ctx* ctx, int domid, uint64_t* generation) {
+    if (!ctx) {
+        *generation = 0;
+        return 0;
+    }
+    if (xc_domain_gfn_to_mfn_batch(libxl_ctx_xch(ctx), domid, 0, NULL, NULL, NULL, generation) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// mfns[i] is 0 if first_gfn + i is not mapped
+int a3_xen_gfn_to_mfn_range(libxl_ctx* ctx, int domid, unsigned long first_gfn, unsigned long nr_gfns, unsigned long* mfns) {
+    unsigned long gfns[XEN_DOMCTL_GFN_TO_MFN_BATCH_MAX];
+    unsigned long done = 0;
+    unsigned long i;
+
+    while (done < nr_gfns) {
+        unsigned long nr = XEN_DOMCTL_GFN_TO_MFN_BATCH_MAX;
+        if (nr_gfns - done < nr) {
+            nr = nr_gfns - done;
+        }
+        for (i = 0; i < nr; ++i) {
+            gfns[i] = first_gfn + done + i;
+        }
+        a3_xen_gfn_to_mfn_batch(ctx, domid, gfns, nr, mfns + done);
+        done += nr;
+    }
+    return 0;
+}
+
 /* vim: set sw=4 ts=4 et tw=80 : */
@@ -6,10 +6,28 @@ extern "C" {
 #endif
 #include <libxl.h>
 
+typedef enum a3_xen_mapping {
+    A3_XEN_UNMAPPED,
+    A3_XEN_MAPPED,
+    A3_XEN_READ_ONLY  // reads go to the device, writes are trapped
+} a3_xen_mapping_t;
+
+typedef struct a3_xen_memory_mapping {
+    unsigned long first_gfn;
+    unsigned long first_mfn;
+    unsigned long nr_mfns;
+    a3_xen_mapping_t mapping;
+} a3_xen_memory_mapping_t;
+
 int a3_xen_add_memory_mapping(libxl_ctx* ctx, int domid, unsigned long first_gfn, unsigned long first_mfn, unsigned long nr_mfns);
+int a3_xen_add_memory_mapping_read_only(libxl_ctx* ctx, int domid, unsigned long first_gfn, unsigned long first_mfn, unsigned long nr_mfns);
 int a3_xen_remove_memory_mapping(libxl_ctx* ctx, int domid, unsigned long first_gfn, unsigned long first_mfn, unsigned long nr_mfns);
+int a3_xen_memory_mapping_batch(libxl_ctx* ctx, int domid, const a3_xen_memory_mapping_t* extents, unsigned long nr_extents, unsigned long* done);
 void* a3_xen_map_foreign_range(libxl_ctx* ctx, int domid, int size, int prot, unsigned long mfn);
 unsigned long a3_xen_gfn_to_mfn(libxl_ctx* ctx, int domid, unsigned long gfn);
+int a3_xen_gfn_to_mfn_batch(libxl_ctx* ctx, int domid, const unsigned long* gfns, unsigned long nr_gfns, unsigned long* mfns);
+int a3_xen_p2m_generation(libxl_ctx* ctx, int domid, uint64_t* generation);
+int a3_xen_gfn_to_mfn_range(libxl_ctx* ctx, int domid, unsigned long first_gfn, unsigned long nr_gfns, unsigned long* mfns);
 
 #ifdef __cplusplus
 }
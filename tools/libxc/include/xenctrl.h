@@ -1048,6 +1048,24 @@ int xc_domain_set_max_evtchn(xc_interface *xch, uint32_t domid,
  */
 int xc_domain_gfn_to_mfn(xc_interface *xch, uint32_t domid, unsigned long gfn, unsigned long* mfn);
 
+/**
+ * Translate up to XEN_DOMCTL_GFN_TO_MFN_BATCH_MAX guest frames in one call.
+ *
+ * @parm xch a handle to an open hypervisor interface
+ * @parm domid the domain id
+ * @parm nr number of frames
+ * @parm gfns guest frame numbers
+ * @parm mfns machine frame numbers, 0 where errs is non zero
+ * @parm errs per frame error, 0 or -errno
+ * @parm generation if not NULL, set to the p2m generation of the domain
+ *       sampled before the translation. nr may be 0 to only read it
+ * return 0 on success, -1 if the batch itself failed
+ */
+int xc_domain_gfn_to_mfn_batch(xc_interface *xch, uint32_t domid,
+                               unsigned int nr, const xen_pfn_t *gfns,
+                               xen_pfn_t *mfns, int *errs,
+                               uint64_t *generation);
+
 /*
  * CPUPOOL MANAGEMENT FUNCTIONS
  */
@@ -1878,6 +1896,25 @@ int xc_domain_memory_mapping(xc_interface *xch,
                              unsigned long nr_mfns,
                              uint32_t add_mapping);
 
+/**
+ * Apply many XEN_DOMCTL_memory_mapping extents, in order, with as few
+ * hypercalls as possible. Extents applied before a failing one are kept,
+ * a failing add extent is removed again.
+ *
+ * @parm xch a handle to an open hypervisor interface
+ * @parm domid the domain id
+ * @parm nr_extents number of extents
+ * @parm extents ranges to add (DPCI_ADD_MAPPING{,_RO}) or remove
+ * @parm nr_done set to the number of extents applied, i.e. the index of the
+ *       failing extent on failure
+ * return 0 on success, non zero on failure with errno set
+ */
+int xc_domain_memory_mapping_batch(xc_interface *xch,
+                                   uint32_t domid,
+                                   unsigned int nr_extents,
+                                   const xen_domctl_memory_mapping_t *extents,
+                                   unsigned int *nr_done);
+
 int xc_domain_ioport_mapping(xc_interface *xch,
                              uint32_t domid,
                              uint32_t first_gport,
@@ -2238,6 +2238,101 @@ int xc_domain_memory_mapping(
     return ret;
 }
 
+int xc_domain_memory_mapping_batch(
+    xc_interface *xch,
+    uint32_t domid,
+    unsigned int nr_extents,
+    const xen_domctl_memory_mapping_t *extents,
+    unsigned int *nr_done)
+{
+    DECLARE_DOMCTL;
+    DECLARE_NAMED_HYPERCALL_BOUNCE(extents, (void *)extents,
+                                   nr_extents * sizeof(*extents),
+                                   XC_HYPERCALL_BUFFER_BOUNCE_IN);
+    xc_dominfo_t info;
+    unsigned int done = 0, nr;
+    int rc = 0, saved_errno;
+
+    *nr_done = 0;
+    if ( xc_domain_getinfo(xch, domid, 1, &info) != 1 ||
+         info.domid != domid )
+    {
+        PERROR("Could not get info for domain");
+        return -EINVAL;
+    }
+    if ( !xc_core_arch_auto_translated_physmap(&info) )
+    {
+        *nr_done = nr_extents;
+        return 0;
+    }
+
+    if ( !nr_extents )
+        return 0;
+
+    if ( xc_hypercall_bounce_pre(xch, extents) )
+    {
+        PERROR("Could not bounce buffer for memory_mapping_batch");
+        return -1;
+    }
+
+    domctl.cmd = XEN_DOMCTL_memory_mapping_batch;
+    domctl.domain = domid;
+    while ( done < nr_extents )
+    {
+        nr = min_t(unsigned int, nr_extents - done,
+                   XEN_DOMCTL_MEMORY_MAPPING_BATCH_MAX);
+        domctl.u.memory_mapping_batch.nr_extents = nr;
+        domctl.u.memory_mapping_batch.done = 0;
+        set_xen_guest_handle_offset(domctl.u.memory_mapping_batch.extents,
+                                    extents, done);
+        /* Re-invoke on preemption and partially done extents. */
+        do
+            rc = do_domctl(xch, &domctl);
+        while ( !rc && domctl.u.memory_mapping_batch.done < nr );
+
+        done += domctl.u.memory_mapping_batch.done;
+        if ( rc )
+            break;
+    }
+
+    saved_errno = errno;
+    xc_hypercall_bounce_post(xch, extents);
+    errno = saved_errno;
+
+    /*
+     * Fall back to one domctl per extent on hypervisors without the batch
+     * or limiting the extent size (E2BIG).
+     */
+    if ( rc && (errno == ENOSYS || errno == E2BIG) )
+    {
+        for ( rc = 0; done < nr_extents; ++done )
+        {
+            rc = xc_domain_memory_mapping(xch, domid,
+                                          extents[done].first_gfn,
+                                          extents[done].first_mfn,
+                                          extents[done].nr_mfns,
+                                          extents[done].add_mapping);
+            if ( rc )
+                break;
+        }
+    }
+    else if ( rc && extents[done].add_mapping != DPCI_REMOVE_MAPPING )
+    {
+        /*
+         * Undo the failing extent, as xc_domain_memory_mapping does.
+         * Errors here are ignored.
+         */
+        saved_errno = errno;
+        xc_domain_memory_mapping(xch, domid, extents[done].first_gfn,
+                                 extents[done].first_mfn,
+                                 extents[done].nr_mfns, DPCI_REMOVE_MAPPING);
+        errno = saved_errno;
+    }
+
+    *nr_done = done;
+    return rc;
+}
+
 int xc_domain_ioport_mapping(
     xc_interface *xch,
     uint32_t domid,
@@ -2535,6 +2630,49 @@ int xc_domain_gfn_to_mfn(xc_interface *xch, uint32_t domid, unsigned long gfn, u
 
     return rc;
 }
+
+int xc_domain_gfn_to_mfn_batch(xc_interface *xch, uint32_t domid,
+                               unsigned int nr, const xen_pfn_t *gfns,
+                               xen_pfn_t *mfns, int *errs,
+                               uint64_t *generation)
+{
+    DECLARE_DOMCTL;
+    DECLARE_NAMED_HYPERCALL_BOUNCE(gfns, (void *)gfns, nr * sizeof(*gfns),
+                                   XC_HYPERCALL_BUFFER_BOUNCE_IN);
+    DECLARE_HYPERCALL_BOUNCE(mfns, nr * sizeof(*mfns), XC_HYPERCALL_BUFFER_BOUNCE_OUT);
+    DECLARE_HYPERCALL_BOUNCE(errs, nr * sizeof(*errs), XC_HYPERCALL_BUFFER_BOUNCE_OUT);
+    int rc = -1;
+
+    if ( nr > XEN_DOMCTL_GFN_TO_MFN_BATCH_MAX )
+    {
+        errno = E2BIG;
+        return -1;
+    }
+
+    if ( xc_hypercall_bounce_pre(xch, gfns) ||
+         xc_hypercall_bounce_pre(xch, mfns) ||
+         xc_hypercall_bounce_pre(xch, errs) )
+    {
+        PERROR("Could not bounce buffers for gfn_to_mfn_batch");
+        goto out;
+    }
+
+    domctl.cmd = XEN_DOMCTL_gfn_to_mfn_batch;
+    domctl.domain = (domid_t)domid;
+    domctl.u.gfn_to_mfn_batch.nr = nr;
+    set_xen_guest_handle(domctl.u.gfn_to_mfn_batch.gfns, gfns);
+    set_xen_guest_handle(domctl.u.gfn_to_mfn_batch.mfns, mfns);
+    set_xen_guest_handle(domctl.u.gfn_to_mfn_batch.errs, errs);
+    rc = do_domctl(xch, &domctl);
+    if ( !rc && generation )
+        *generation = domctl.u.gfn_to_mfn_batch.generation;
+
+ out:
+    xc_hypercall_bounce_post(xch, gfns);
+    xc_hypercall_bounce_post(xch, mfns);
+    xc_hypercall_bounce_post(xch, errs);
+    return rc;
+}
 /*
  * Local variables:
  * mode: C
@@ -71,6 +71,9 @@ nvc0_state_t* nvc0_state(void* opaque);
 // construct NVC0 context
 void nvc0_context_init(nvc0_state_t* state);
 
+// destruct NVC0 context, stopping its threads
+void nvc0_context_destroy(nvc0_state_t* state);
+
 // nvc0 graph
 #define GPC_MAX 4
 #define TP_MAX 32
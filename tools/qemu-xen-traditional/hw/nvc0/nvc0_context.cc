@@ -32,16 +32,28 @@
 
 namespace nvc0 {
 
+const uint32_t context::kFLUSH_INTERVAL_US;
+const uint32_t context::kPOLL_AREA_CHANNEL_SIZE;
+const uint32_t context::kDOORBELL_OFFSET;
+const uint32_t a3::batch_area_t::kENTRIES;
+
 context::context(nvc0_state_t* state, uint64_t memory_size)
     : state_(state)
     , pramin_()
     , io_service_()
     , socket_(io_service_)
     , socket_mutex_()
-    , req_queue_()
-    , res_queue_()
+    , transport_()
+    , submitted_()
+    , register_page_()
+    , batch_()
+    , batch_seq_()
+    , batch_count_()
+    , poll_area_()
+    , flush_cond_()
+    , stopping_(false)
+    , flusher_()
 {
-
     // initialize connection
     socket_.connect(boost::asio::local::stream_protocol::endpoint(A3_ENDPOINT));
 
@@ -54,35 +66,27 @@ context::context(nvc0_state_t* state, uint64_t memory_size)
     const a3::command res = send(cmd);
     id_ = res.value;
 
-    // initialize req/res queue
-    std::vector<char> name(200);
-    {
-
-        const int ret = std::snprintf(name.data(), name.size() - 1, "a3_shared_req_queue_%u", id());
-        if (ret < 0) {
-            std::perror(NULL);
-            std::exit(1);
-        }
-        name[ret] = '\0';
-
-        req_queue_.reset(new a3::interprocess::message_queue(a3::interprocess::open_only, name.data()));
-    }
+    // initialize req/res transport. A3 tells which transport is used
+    transport_.reset(a3::transport_t::open(static_cast<a3::transport_t::type_t>(res.offset), id()));
+    register_page_.reset(new a3::shared_region_t<a3::register_page_t>(false, a3::shared_name("a3_shared_registers_%u", id())));
+    batch_.reset(new a3::shared_region_t<a3::batch_area_t>(false, a3::shared_name("a3_shared_batch_%u", id())));
+    flusher_.reset(new boost::thread(&context::flusher, this));
+}
 
+context::~context() {
     {
-        const int ret = std::snprintf(name.data(), name.size() - 1, "a3_shared_res_queue_%u", id());
-        if (ret < 0) {
-            std::perror(NULL);
-            std::exit(1);
-        }
-        name[ret] = '\0';
-
-        // construct new queue
-        res_queue_.reset(new a3::interprocess::message_queue(a3::interprocess::open_only, name.data()));
+        boost::mutex::scoped_lock lock(socket_mutex_);
+        // posted writes are not dropped with the flusher
+        flush_batch();
+        stopping_ = true;
+        flush_cond_.notify_one();
     }
+    flusher_->join();
 }
 
 a3::command context::send(const a3::command& cmd) {
     boost::mutex::scoped_lock lock(socket_mutex_);
+    flush_batch();
     a3::command result = { };
     while (true) {
         boost::system::error_code error;
@@ -110,23 +114,133 @@ a3::command context::send(const a3::command& cmd) {
     return result;
 }
 
+// qemu-dm dispatches ioreqs from one thread and A3 serves a context in order,
+// so a read waits for its response with socket_mutex_ held.
 a3::command context::message(const a3::command& cmd, bool read) {
     boost::mutex::scoped_lock lock(socket_mutex_);
-    req_queue_->send(&cmd, sizeof(a3::command), 0);
+    flush_batch();
+    transport_->send_request(cmd);
+    ++submitted_;
     if (read) {
         a3::command result = { };
-        unsigned int priority;
-        std::size_t size;
-        res_queue_->receive(&result, sizeof(a3::command), size, priority);
+        transport_->receive_response(&result);
         return result;
     }
     return a3::command();
 }
 
+void context::post(const a3::command& cmd) {
+    boost::mutex::scoped_lock lock(socket_mutex_);
+    while (batch_count_ == 0 && !(*batch_)->writable(batch_seq_)) {
+        // wait until A3 finishes the batch previously held in this buffer.
+        // sleeps without socket_mutex_, so reads and the flusher go on
+        const uint32_t seq = batch_seq_;
+        lock.unlock();
+        (*batch_)->wait_writable(seq);
+        lock.lock();
+    }
+    (*batch_)->buffer(batch_seq_)[batch_count_++] = cmd;
+    if (batch_count_ == 1) {
+        flush_cond_.notify_one();
+    }
+
+    if (cmd.bar() == a3::command::BAR0 && cmd.offset == 0x2254) {
+        poll_area_ = static_cast<uint64_t>(cmd.value & 0xfffffff) << 12;
+    }
+
+    if (batch_count_ == a3::batch_area_t::kENTRIES || is_ordering_write(cmd)) {
+        flush_batch();
+    }
+}
+
+void context::flush() {
+    boost::mutex::scoped_lock lock(socket_mutex_);
+    flush_batch();
+}
+
+bool context::read_cached(uint32_t offset, uint32_t* value) {
+    boost::mutex::scoped_lock lock(socket_mutex_);
+    if (batch_count_ || (*register_page_)->processed.load(std::memory_order_acquire) != submitted_) {
+        // posted writes may change the value
+        return false;
+    }
+    return (*register_page_)->lookup(offset, value);
+}
+
+// socket_mutex_ should be held
+void context::flush_batch() {
+    if (!batch_count_) {
+        return;
+    }
+    const a3::command cmd = {
+        a3::command::TYPE_BATCH,
+        batch_count_,
+        batch_seq_
+    };
+    transport_->send_request(cmd);
+    ++submitted_;
+    ++batch_seq_;
+    batch_count_ = 0;
+}
+
+// Writes which kick the GPU must be delivered to A3 immediately, since the
+// guest observes the result through its memory, not through MMIO reads.
+bool context::is_ordering_write(const a3::command& cmd) const {
+    switch (cmd.bar()) {
+    case a3::command::BAR0:
+        switch (cmd.offset) {
+        case 0x002274:  // playlist update
+        case 0x002634:  // channel kill
+        case 0x100cbc:  // TLB flush
+        case 0x409504:  // PGRAPH context control
+            return true;
+        }
+        return false;
+
+    case a3::command::BAR1:
+        // doorbell (USER_PUT) of a channel in the poll area. the guest sees an
+        // NVC0 (NV03_PMC_BOOT_0), so each channel has 0x1000 bytes
+        if (cmd.offset >= poll_area_ && (cmd.offset - poll_area_) < A3_DOMAIN_CHANNELS * kPOLL_AREA_CHANNEL_SIZE) {
+            return ((cmd.offset - poll_area_) % kPOLL_AREA_CHANNEL_SIZE) == kDOORBELL_OFFSET;
+        }
+        return false;
+
+    default:
+        return false;
+    }
+}
+
+void context::flusher() {
+    // drains the batch when the guest stops writing. sleeps while no posted
+    // write is pending
+    boost::mutex::scoped_lock lock(socket_mutex_);
+    while (!stopping_) {
+        if (!batch_count_) {
+            flush_cond_.wait(lock);
+            continue;
+        }
+        const uint32_t seq = batch_seq_;
+        flush_cond_.timed_wait(lock, boost::posix_time::microseconds(kFLUSH_INTERVAL_US));
+        if (batch_seq_ == seq) {
+            flush_batch();
+        }
+    }
+}
+
 context* context::extract(nvc0_state_t* state) {
     return static_cast<context*>(state->priv);
 }
 
+void context::notify_bar1_change() {
+    const uint64_t address = state_->bar[1].addr;
+    const a3::command cmd = {
+        a3::command::TYPE_BAR1,
+        static_cast<uint32_t>(address >> 32),
+        static_cast<uint32_t>(address)
+    };
+    send(cmd);
+}
+
 void context::notify_bar3_change() {
     const uint64_t address = state_->bar[3].addr;
     const a3::command cmd = {
@@ -143,4 +257,9 @@ extern "C" void nvc0_context_init(nvc0_state_t* state) {
     // currenty, 1GB
     state->priv = static_cast<void*>(new nvc0::context(state, A3_MEMORY_SIZE));
 }
+
+extern "C" void nvc0_context_destroy(nvc0_state_t* state) {
+    delete nvc0::context::extract(state);
+    state->priv = NULL;
+}
 /* vim: set sw=4 ts=4 et tw=80 : */
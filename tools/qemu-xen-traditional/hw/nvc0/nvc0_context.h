@@ -6,11 +6,16 @@
 #include <boost/scoped_ptr.hpp>
 #include "nvc0.h"
 #include "a3/a3.h"
+#include "a3/transport.h"
+#include "a3/batch.h"
+#include "a3/shared_region.h"
+#include "a3/register_page.h"
 namespace nvc0 {
 
 class context {
  public:
     explicit context(nvc0_state_t* state, uint64_t memory_size);
+    ~context();
     nvc0_state_t* state() const { return state_; }
     uint64_t pramin() const { return pramin_; }
     void set_pramin(uint64_t pramin) { pramin_ = pramin; }
@@ -19,11 +24,24 @@ class context {
     a3::command send(const a3::command& cmd);
     // message passing
     a3::command message(const a3::command& cmd, bool read);
+    // posted write, buffered into the batch
+    void post(const a3::command& cmd);
+    void flush();
+    // answers BAR0 register read from the shared register page if possible
+    bool read_cached(uint32_t offset, uint32_t* value);
+    void notify_bar1_change();
     void notify_bar3_change();
 
     static context* extract(nvc0_state_t* state);
 
  private:
+    static const uint32_t kFLUSH_INTERVAL_US = 100;
+    static const uint32_t kPOLL_AREA_CHANNEL_SIZE = 0x1000;
+    static const uint32_t kDOORBELL_OFFSET = 0x8C;
+    void flush_batch();
+    bool is_ordering_write(const a3::command& cmd) const;
+    void flusher();
+
     uint32_t id_;
     nvc0_state_t* state_;
     uint64_t pramin_;  // 16bit shifted
@@ -32,8 +50,18 @@ class context {
     boost::asio::io_service io_service_;
     boost::asio::local::stream_protocol::socket socket_;
     boost::mutex socket_mutex_;
-    boost::scoped_ptr<a3::interprocess::message_queue> req_queue_;
-    boost::scoped_ptr<a3::interprocess::message_queue> res_queue_;
+    boost::scoped_ptr<a3::transport_t> transport_;
+    uint32_t submitted_;
+    boost::scoped_ptr<a3::shared_region_t<a3::register_page_t> > register_page_;
+
+    // posted-write batching
+    boost::scoped_ptr<a3::shared_region_t<a3::batch_area_t> > batch_;
+    uint32_t batch_seq_;
+    uint32_t batch_count_;
+    uint64_t poll_area_;
+    boost::condition_variable flush_cond_;  // with socket_mutex_
+    bool stopping_;
+    boost::scoped_ptr<boost::thread> flusher_;
 };
 
 }  // namespace nvc0
@@ -175,6 +175,14 @@ static void nvc0_init_real_device(nvc0_state_t* state, uint8_t r_bus, uint8_t r_
 //         Capabilities: [600 v1] Vendor Specific Information: ID=0001 Rev=1 Len=024 <?>
 //         Kernel driver in use: pciback
 //         Kernel modules: nouveau, nvidiafb
+static int pci_nvc0_unregister(PCIDevice* dev) {
+    nvc0_state_t* state = nvc0_state(dev);
+    if (state->priv) {
+        nvc0_context_destroy(state);
+    }
+    return 0;
+}
+
 struct pt_dev * pci_nvc0_init(PCIBus *bus, const char *e_dev_name) {
     struct pt_dev_with_state* result;
     nvc0_state_t* state;
@@ -185,6 +193,7 @@ struct pt_dev * pci_nvc0_init(PCIBus *bus, const char *e_dev_name) {
     result = (struct pt_dev_with_state*)pci_register_device(bus, "nvc0", sizeof(struct pt_dev_with_state), -1, NULL, NULL);
     state = nvc0_state(result);
     state->device = (struct pt_dev*)result;
+    state->device->dev.unregister = pci_nvc0_unregister;
 
     // FIXME(Yusuke Suzuki)
     // set correct guest id
@@ -210,6 +210,11 @@ static void nvc0_mmio_map(PCIDevice *dev, int region_num, uint32_t addr, uint32_
 
     cpu_register_physical_memory(addr, size, io_index);
 
+    // notify BAR1 to A3
+    if (region_num == 1) {
+        nvc0_mmio_bar1_notify(state);
+    }
+
     // notify BAR3 to A3
     if (region_num == 3) {
         nvc0_mmio_bar3_notify(state);
@@ -8,6 +8,7 @@ extern "C" {
 
 void nvc0_mmio_init(nvc0_state_t* state);
 void nvc0_api_paravirt_mmio_init(nvc0_state_t* state);
+void nvc0_mmio_bar1_notify(nvc0_state_t* state);
 void nvc0_mmio_bar3_notify(nvc0_state_t* state);
 
 // wrappers
@@ -114,7 +114,7 @@ extern "C" void nvc0_mmio_bar0_writeb(void *opaque, target_phys_addr_t addr, uin
         nvc0_write8(cmd.value, state->bar[0].space + cmd.offset);
         return;
     }
-    ctx->message(cmd, false);
+    ctx->post(cmd);
 }
 
 extern "C" void nvc0_mmio_bar0_writew(void *opaque, target_phys_addr_t addr, uint32_t val) {
@@ -131,7 +131,7 @@ extern "C" void nvc0_mmio_bar0_writew(void *opaque, target_phys_addr_t addr, uin
         nvc0_write16(cmd.value, state->bar[0].space + cmd.offset);
         return;
     }
-    ctx->message(cmd, false);
+    ctx->post(cmd);
 }
 
 extern "C" uint32_t nvc0_mmio_bar0_readd(void *opaque, target_phys_addr_t addr) {
@@ -174,6 +174,10 @@ extern "C" uint32_t nvc0_mmio_bar0_readd(void *opaque, target_phys_addr_t addr)
             return ret;
         }
 
+        if (ctx->read_cached(cmd.offset, &ret)) {
+            goto end;
+        }
+
         ret = ctx->message(cmd, true).value;
     }
 
@@ -227,7 +231,7 @@ extern "C" void nvc0_mmio_bar0_writed(void *opaque, target_phys_addr_t addr, uin
         nvc0_write32(cmd.value, state->bar[0].space + cmd.offset);
         return;
     }
-    ctx->message(cmd, false);
+    ctx->post(cmd);
     return;
 }
 /* vim: set sw=4 ts=4 et tw=80 : */
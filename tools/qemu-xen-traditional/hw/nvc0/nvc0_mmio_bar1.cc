@@ -28,6 +28,7 @@
 #include "nvc0_mmio.h"
 #include "nvc0_mmio_bar1.h"
 #include "nvc0_vm.h"
+#include "nvc0_context.h"
 
 // BAR 1:
 //   VRAM. On pre-NV50, corresponds directly to the available VRAM on card.
@@ -70,4 +71,8 @@ extern "C" void nvc0_mmio_bar1_writed(void *opaque, target_phys_addr_t addr, uin
     const target_phys_addr_t offset = addr - state->bar[1].addr;
     nvc0::vm_bar1_write<sizeof(uint32_t)>(state, offset, val);
 }
+
+extern "C" void nvc0_mmio_bar1_notify(nvc0_state_t* state) {
+    nvc0::context::extract(state)->notify_bar1_change();
+}
 /* vim: set sw=4 ts=4 et tw=80 : */
@@ -1455,6 +1455,61 @@ long arch_do_domctl(
     }
         break;
 
+    case XEN_DOMCTL_gfn_to_mfn_batch:
+    {
+        struct domain *d;
+        unsigned int nr = domctl->u.gfn_to_mfn_batch.nr;
+
+        ret = -E2BIG;
+        if ( unlikely(nr > XEN_DOMCTL_GFN_TO_MFN_BATCH_MAX) )
+            break;
+
+        ret = -ESRCH;
+        d = rcu_lock_domain_by_id(domctl->domain);
+        if ( d == NULL )
+            break;
+
+        domctl->u.gfn_to_mfn_batch.generation =
+            read_atomic(&p2m_get_hostp2m(d)->generation);
+        smp_rmb();
+        copyback = 1;
+
+        ret = 0;
+        for ( i = 0; i < nr; ++i )
+        {
+            struct page_info *page;
+            xen_pfn_t gfn, mfn = 0;
+            int err = 0;
+
+            if ( copy_from_guest_offset(&gfn, domctl->u.gfn_to_mfn_batch.gfns,
+                                        i, 1) )
+            {
+                ret = -EFAULT;
+                break;
+            }
+
+            page = get_page_from_gfn(d, gfn, NULL, P2M_ALLOC);
+            if ( page )
+            {
+                mfn = page_to_mfn(page);
+                put_page(page);
+            }
+            else
+                err = -ENOMEM;
+
+            if ( copy_to_guest_offset(domctl->u.gfn_to_mfn_batch.mfns,
+                                      i, &mfn, 1) ||
+                 copy_to_guest_offset(domctl->u.gfn_to_mfn_batch.errs,
+                                      i, &err, 1) )
+            {
+                ret = -EFAULT;
+                break;
+            }
+        }
+        rcu_unlock_domain(d);
+    }
+        break;
+
     default:
         ret = iommu_do_domctl(domctl, d, u_domctl);
         break;
@@ -1072,7 +1072,8 @@ static int hvmemul_rep_ins(
         return rc;
 
     (void) get_gfn_query_unlocked(current->domain, gpa >> PAGE_SHIFT, &p2mt);
-    if ( p2mt == p2m_mmio_direct || p2mt == p2m_mmio_dm )
+    if ( p2mt == p2m_mmio_direct || p2mt == p2m_mmio_dm ||
+         p2mt == p2m_mmio_write_dm )
         return X86EMUL_UNHANDLEABLE;
 
     return hvmemul_do_pio_addr(src_port, reps, bytes_per_rep, IOREQ_READ,
@@ -1141,7 +1142,8 @@ static int hvmemul_rep_outs(
         return rc;
 
     (void) get_gfn_query_unlocked(current->domain, gpa >> PAGE_SHIFT, &p2mt);
-    if ( p2mt == p2m_mmio_direct || p2mt == p2m_mmio_dm )
+    if ( p2mt == p2m_mmio_direct || p2mt == p2m_mmio_dm ||
+         p2mt == p2m_mmio_write_dm )
         return X86EMUL_UNHANDLEABLE;
 
     return hvmemul_do_pio_addr(dst_port, reps, bytes_per_rep, IOREQ_WRITE,
@@ -1223,6 +1225,7 @@ static int hvmemul_rep_movs(
     (void) get_gfn_query_unlocked(current->domain, dgpa >> PAGE_SHIFT, &dp2mt);
 
     if ( sp2mt == p2m_mmio_direct || dp2mt == p2m_mmio_direct ||
+         sp2mt == p2m_mmio_write_dm || dp2mt == p2m_mmio_write_dm ||
          (sp2mt == p2m_mmio_dm && dp2mt == p2m_mmio_dm) )
         return X86EMUL_UNHANDLEABLE;
 
@@ -1415,6 +1418,7 @@ static int hvmemul_rep_stos(
                  gpa, *reps, bytes_per_rep);
         /* fall through */
     case p2m_mmio_direct:
+    case p2m_mmio_write_dm:
         return X86EMUL_UNHANDLEABLE;
 
     case p2m_mmio_dm:
@@ -1929,11 +1929,12 @@ int hvm_hap_nested_page_fault(paddr_t gpa, unsigned long gla,
 
     /*
      * If this GFN is emulated MMIO or marked as read-only, pass the fault
-     * to the mmio handler.
+     * to the mmio handler. Writes to read-only MMIO go to the device model.
      */
     if ( (p2mt == p2m_mmio_dm) || 
          (npfec.write_access &&
-          (p2m_is_discard_write(p2mt) || (p2mt == p2m_ioreq_server))) )
+          (p2m_is_discard_write(p2mt) || (p2mt == p2m_ioreq_server) ||
+           (p2mt == p2m_mmio_write_dm))) )
     {
         __put_gfn(p2m, gfn);
         if ( ap2m_active )
@@ -121,6 +121,8 @@ static unsigned long p2m_type_to_flags(p2m_type_t t, mfn_t mfn,
             ASSERT(!level);
         }
         return flags | P2M_BASE_FLAGS | _PAGE_PCD;
+    case p2m_mmio_write_dm:
+        return flags | P2M_BASE_FLAGS | _PAGE_PCD | _PAGE_NX_BIT;
     }
 }
 
@@ -583,7 +585,8 @@ p2m_pt_set_entry(struct p2m_domain *p2m, unsigned long gfn, mfn_t mfn,
             }
         }
 
-        ASSERT(!mfn_valid(mfn) || p2mt != p2m_mmio_direct);
+        ASSERT(!mfn_valid(mfn) ||
+               (p2mt != p2m_mmio_direct && p2mt != p2m_mmio_write_dm));
         l3e_content = mfn_valid(mfn) || p2m_allows_invalid_mfn(p2mt)
             ? p2m_l3e_from_pfn(mfn_x(mfn), p2m_type_to_flags(p2mt, mfn, 2))
             : l3e_empty();
@@ -654,7 +657,8 @@ p2m_pt_set_entry(struct p2m_domain *p2m, unsigned long gfn, mfn_t mfn,
             }
         }
         
-        ASSERT(!mfn_valid(mfn) || p2mt != p2m_mmio_direct);
+        ASSERT(!mfn_valid(mfn) ||
+               (p2mt != p2m_mmio_direct && p2mt != p2m_mmio_write_dm));
         l2e_content = mfn_valid(mfn) || p2m_allows_invalid_mfn(p2mt)
             ? p2m_l2e_from_pfn(mfn_x(mfn), p2m_type_to_flags(p2mt, mfn, 1))
             : l2e_empty();
@@ -1088,6 +1092,7 @@ long p2m_pt_audit_p2m(struct p2m_domain *p2m)
                         m2pfn = get_gpfn_from_mfn(mfn);
                         if ( m2pfn != gfn &&
                              type != p2m_mmio_direct &&
+                             type != p2m_mmio_write_dm &&
                              !p2m_is_grant(type) &&
                              !p2m_is_shared(type) )
                         {
@@ -466,6 +466,30 @@ struct page_info *get_page_from_gfn_p2m(
     return page;
 }
 
+/*
+ * Whether setting the 2^order entries at gfn changes a gfn->mfn translation
+ * of guest memory, which p2m->generation reports. Type flips keeping the mfn
+ * (log-dirty) and MMIO remaps do not.
+ */
+static bool_t p2m_translation_changes(struct p2m_domain *p2m,
+                                      unsigned long gfn, mfn_t mfn,
+                                      unsigned int order, p2m_type_t nt)
+{
+    p2m_type_t ot;
+    p2m_access_t a;
+    unsigned int cur_order = PAGE_ORDER_4K;
+    mfn_t omfn = p2m->get_entry(p2m, gfn, &ot, &a, 0, &cur_order, NULL);
+
+    /* Old entries of the range may differ from the first one */
+    if ( cur_order < order )
+        return 1;
+
+    if ( p2m_is_ram(ot) && p2m_is_ram(nt) )
+        return !mfn_eq(omfn, mfn);
+
+    return p2m_is_any_ram(ot) || p2m_is_any_ram(nt);
+}
+
 /* Returns: 0 for success, -errno for failure */
 int p2m_set_entry(struct p2m_domain *p2m, unsigned long gfn, mfn_t mfn,
                   unsigned int page_order, p2m_type_t p2mt, p2m_access_t p2ma)
@@ -474,6 +498,7 @@ int p2m_set_entry(struct p2m_domain *p2m, unsigned long gfn, mfn_t mfn,
     unsigned long todo = 1ul << page_order;
     unsigned int order;
     int set_rc, rc = 0;
+    bool_t changed = 0;
 
     ASSERT(gfn_locked_by_me(p2m, gfn));
 
@@ -492,6 +517,9 @@ int p2m_set_entry(struct p2m_domain *p2m, unsigned long gfn, mfn_t mfn,
         else
             order = 0;
 
+        if ( !changed && p2m_is_hostp2m(p2m) )
+            changed = p2m_translation_changes(p2m, gfn, mfn, order, p2mt);
+
         set_rc = p2m->set_entry(p2m, gfn, mfn, order, p2mt, p2ma, -1);
         if ( set_rc )
             rc = set_rc;
@@ -502,6 +530,9 @@ int p2m_set_entry(struct p2m_domain *p2m, unsigned long gfn, mfn_t mfn,
         todo -= 1ul << order;
     }
 
+    if ( changed )
+        p2m->generation++;
+
     return rc;
 }
 
@@ -1032,6 +1063,16 @@ int set_mmio_p2m_entry(struct domain *d, unsigned long gfn, mfn_t mfn,
     return set_typed_p2m_entry(d, gfn, mfn, order, p2m_mmio_direct, access);
 }
 
+/*
+ * Map MMIO read-only: reads go to the device, writes fault and are
+ * forwarded to the device model.
+ */
+int set_mmio_ro_p2m_entry(struct domain *d, unsigned long gfn, mfn_t mfn,
+                          unsigned int order, p2m_access_t access)
+{
+    return set_typed_p2m_entry(d, gfn, mfn, order, p2m_mmio_write_dm, access);
+}
+
 int set_identity_p2m_entry(struct domain *d, unsigned long gfn,
                            p2m_access_t p2ma, unsigned int flag)
 {
@@ -1111,7 +1152,8 @@ int clear_mmio_p2m_entry(struct domain *d, unsigned long gfn, mfn_t mfn,
     }
 
     /* Do not use mfn_valid() here as it will usually fail for MMIO pages. */
-    if ( mfn_eq(actual_mfn, INVALID_MFN) || (t != p2m_mmio_direct) )
+    if ( mfn_eq(actual_mfn, INVALID_MFN) ||
+         (t != p2m_mmio_direct && t != p2m_mmio_write_dm) )
     {
         gdprintk(XENLOG_ERR,
                  "gfn_to_mfn failed! gfn=%08lx type:%d\n", gfn, t);
@@ -2281,10 +2323,11 @@ static unsigned int mmio_order(const struct domain *d,
 
 #define MAP_MMIO_MAX_ITER 64 /* pretty arbitrary */
 
-int map_mmio_regions(struct domain *d,
-                     gfn_t start_gfn,
-                     unsigned long nr,
-                     mfn_t mfn)
+static int map_typed_mmio_regions(struct domain *d,
+                                  gfn_t start_gfn,
+                                  unsigned long nr,
+                                  mfn_t mfn,
+                                  bool_t readonly)
 {
     int ret = 0;
     unsigned long i;
@@ -2300,9 +2343,14 @@ int map_mmio_regions(struct domain *d,
         for ( order = mmio_order(d, (gfn_x(start_gfn) + i) | (mfn_x(mfn) + i), nr - i); ;
               order = ret - 1 )
         {
-            ret = set_mmio_p2m_entry(d, gfn_x(start_gfn) + i,
-                                     mfn_add(mfn, i), order,
-                                     p2m_get_hostp2m(d)->default_access);
+            if ( readonly )
+                ret = set_mmio_ro_p2m_entry(d, gfn_x(start_gfn) + i,
+                                            mfn_add(mfn, i), order,
+                                            p2m_get_hostp2m(d)->default_access);
+            else
+                ret = set_mmio_p2m_entry(d, gfn_x(start_gfn) + i,
+                                         mfn_add(mfn, i), order,
+                                         p2m_get_hostp2m(d)->default_access);
             if ( ret <= 0 )
                 break;
             ASSERT(ret <= order);
@@ -2314,6 +2362,22 @@ int map_mmio_regions(struct domain *d,
     return i == nr ? 0 : i ?: ret;
 }
 
+int map_mmio_regions(struct domain *d,
+                     gfn_t start_gfn,
+                     unsigned long nr,
+                     mfn_t mfn)
+{
+    return map_typed_mmio_regions(d, start_gfn, nr, mfn, 0);
+}
+
+int map_mmio_regions_ro(struct domain *d,
+                        gfn_t start_gfn,
+                        unsigned long nr,
+                        mfn_t mfn)
+{
+    return map_typed_mmio_regions(d, start_gfn, nr, mfn, 1);
+}
+
 int unmap_mmio_regions(struct domain *d,
                        gfn_t start_gfn,
                        unsigned long nr,
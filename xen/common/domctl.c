@@ -380,6 +380,75 @@ static struct vnuma_info *vnuma_init(const struct xen_domctl_vnuma *uinfo,
     return ERR_PTR(ret);
 }
 
+/*
+ * Add or remove one MMIO range of XEN_DOMCTL_memory_mapping. Returns 0,
+ * the number of frames done on partial success, or -errno. The caller
+ * calls memory_type_changed().
+ */
+static long memory_mapping(struct domain *d,
+                           const struct xen_domctl_memory_mapping *mapping)
+{
+    unsigned long gfn = mapping->first_gfn;
+    unsigned long mfn = mapping->first_mfn;
+    unsigned long nr_mfns = mapping->nr_mfns;
+    unsigned long mfn_end = mfn + nr_mfns - 1;
+    int add = mapping->add_mapping;
+    long ret;
+
+    if ( mfn_end < mfn || /* wrap? */
+         ((mfn | mfn_end) >> (paddr_bits - PAGE_SHIFT)) ||
+         (gfn + nr_mfns - 1) < gfn ) /* wrap? */
+        return -EINVAL;
+
+#ifndef CONFIG_X86 /* XXX ARM!? */
+    /* Must break hypercall up as this could take a while. */
+    if ( nr_mfns > 64 )
+        return -E2BIG;
+#endif
+
+    if ( !iomem_access_permitted(current->domain, mfn, mfn_end) ||
+         !iomem_access_permitted(d, mfn, mfn_end) )
+        return -EPERM;
+
+    ret = xsm_iomem_mapping(XSM_HOOK, d, mfn, mfn_end, add);
+    if ( ret )
+        return ret;
+
+    if ( add )
+    {
+        printk(XENLOG_G_DEBUG
+               "memory_map:add: dom%d gfn=%lx mfn=%lx nr=%lx\n",
+               d->domain_id, gfn, mfn, nr_mfns);
+
+        if ( add == DPCI_ADD_MAPPING_RO )
+#ifdef CONFIG_X86
+            ret = map_mmio_regions_ro(d, _gfn(gfn), nr_mfns, _mfn(mfn));
+#else
+            ret = -EOPNOTSUPP;
+#endif
+        else
+            ret = map_mmio_regions(d, _gfn(gfn), nr_mfns, _mfn(mfn));
+        if ( ret < 0 )
+            printk(XENLOG_G_WARNING
+                   "memory_map:fail: dom%d gfn=%lx mfn=%lx nr=%lx ret:%ld\n",
+                   d->domain_id, gfn, mfn, nr_mfns, ret);
+    }
+    else
+    {
+        printk(XENLOG_G_DEBUG
+               "memory_map:remove: dom%d gfn=%lx mfn=%lx nr=%lx\n",
+               d->domain_id, gfn, mfn, nr_mfns);
+
+        ret = unmap_mmio_regions(d, _gfn(gfn), nr_mfns, _mfn(mfn));
+        if ( ret < 0 && is_hardware_domain(current->domain) )
+            printk(XENLOG_ERR
+                   "memory_map: error %ld removing dom%d access to [%lx,%lx]\n",
+                   ret, d->domain_id, mfn, mfn_end);
+    }
+
+    return ret;
+}
+
 long do_domctl(XEN_GUEST_HANDLE_PARAM(xen_domctl_t) u_domctl)
 {
     long ret = 0;
@@ -1004,61 +1073,58 @@ long do_domctl(XEN_GUEST_HANDLE_PARAM(xen_domctl_t) u_domctl)
     }
 
     case XEN_DOMCTL_memory_mapping:
-    {
-        unsigned long gfn = op->u.memory_mapping.first_gfn;
-        unsigned long mfn = op->u.memory_mapping.first_mfn;
-        unsigned long nr_mfns = op->u.memory_mapping.nr_mfns;
-        unsigned long mfn_end = mfn + nr_mfns - 1;
-        int add = op->u.memory_mapping.add_mapping;
+        ret = memory_mapping(d, &op->u.memory_mapping);
+        /* Do this unconditionally to cover errors on failure paths. */
+        memory_type_changed(d);
+        break;
 
-        ret = -EINVAL;
-        if ( mfn_end < mfn || /* wrap? */
-             ((mfn | mfn_end) >> (paddr_bits - PAGE_SHIFT)) ||
-             (gfn + nr_mfns - 1) < gfn ) /* wrap? */
-            break;
+    case XEN_DOMCTL_memory_mapping_batch:
+    {
+        struct xen_domctl_memory_mapping_batch *batch =
+            &op->u.memory_mapping_batch;
 
-#ifndef CONFIG_X86 /* XXX ARM!? */
         ret = -E2BIG;
-        /* Must break hypercall up as this could take a while. */
-        if ( nr_mfns > 64 )
-            break;
-#endif
-
-        ret = -EPERM;
-        if ( !iomem_access_permitted(current->domain, mfn, mfn_end) ||
-             !iomem_access_permitted(d, mfn, mfn_end) )
-            break;
-
-        ret = xsm_iomem_mapping(XSM_HOOK, d, mfn, mfn_end, add);
-        if ( ret )
+        if ( batch->nr_extents > XEN_DOMCTL_MEMORY_MAPPING_BATCH_MAX )
             break;
 
-        if ( add )
+        ret = 0;
+        while ( batch->done < batch->nr_extents )
         {
-            printk(XENLOG_G_DEBUG
-                   "memory_map:add: dom%d gfn=%lx mfn=%lx nr=%lx\n",
-                   d->domain_id, gfn, mfn, nr_mfns);
+            struct xen_domctl_memory_mapping extent;
 
-            ret = map_mmio_regions(d, _gfn(gfn), nr_mfns, _mfn(mfn));
+            if ( copy_from_guest_offset(&extent, batch->extents,
+                                        batch->done, 1) )
+            {
+                ret = -EFAULT;
+                break;
+            }
+
+            ret = memory_mapping(d, &extent);
+            /* Removal errors are ignored, as xc_domain_memory_mapping does. */
+            if ( ret < 0 && extent.add_mapping == DPCI_REMOVE_MAPPING )
+                ret = 0;
             if ( ret < 0 )
-                printk(XENLOG_G_WARNING
-                       "memory_map:fail: dom%d gfn=%lx mfn=%lx nr=%lx ret:%ld\n",
-                       d->domain_id, gfn, mfn, nr_mfns, ret);
-        }
-        else
-        {
-            printk(XENLOG_G_DEBUG
-                   "memory_map:remove: dom%d gfn=%lx mfn=%lx nr=%lx\n",
-                   d->domain_id, gfn, mfn, nr_mfns);
-
-            ret = unmap_mmio_regions(d, _gfn(gfn), nr_mfns, _mfn(mfn));
-            if ( ret < 0 && is_hardware_domain(current->domain) )
-                printk(XENLOG_ERR
-                       "memory_map: error %ld removing dom%d access to [%lx,%lx]\n",
-                       ret, d->domain_id, mfn, mfn_end);
+                break;
+
+            if ( ret > 0 )
+            {
+                /* Partial success, the caller re-invokes from this extent. */
+                extent.first_gfn += ret;
+                extent.first_mfn += ret;
+                extent.nr_mfns -= ret;
+                ret = copy_to_guest_offset(batch->extents, batch->done,
+                                           &extent, 1) ? -EFAULT : 0;
+                break;
+            }
+
+            ++batch->done;
+            if ( batch->done < batch->nr_extents && hypercall_preempt_check() )
+                break;
         }
-        /* Do this unconditionally to cover errors on above failure paths. */
+
+        /* Once for the whole batch, covering failure paths as well. */
         memory_type_changed(d);
+        copyback = 1;
         break;
     }
 
@@ -72,6 +72,7 @@ typedef enum {
     p2m_ram_broken = 13,          /* Broken page, access cause domain crash */
     p2m_map_foreign  = 14,        /* ram pages from foreign domain */
     p2m_ioreq_server = 15,
+    p2m_mmio_write_dm = 16,       /* Read-only MMIO, writes go to the DM */
 } p2m_type_t;
 
 /* Modifiers to the query */
@@ -105,14 +106,16 @@ typedef unsigned int p2m_query_t;
 
 /* MMIO types, which don't have to map to anything in the frametable */
 #define P2M_MMIO_TYPES (p2m_to_mask(p2m_mmio_dm)        \
-                        | p2m_to_mask(p2m_mmio_direct))
+                        | p2m_to_mask(p2m_mmio_direct)  \
+                        | p2m_to_mask(p2m_mmio_write_dm))
 
 /* Read-only types, which must have the _PAGE_RW bit clear in their PTEs */
 #define P2M_RO_TYPES (p2m_to_mask(p2m_ram_logdirty)     \
                       | p2m_to_mask(p2m_ram_ro)         \
                       | p2m_to_mask(p2m_grant_map_ro)   \
                       | p2m_to_mask(p2m_ram_shared)     \
-                      | p2m_to_mask(p2m_ioreq_server))
+                      | p2m_to_mask(p2m_ioreq_server)  \
+                      | p2m_to_mask(p2m_mmio_write_dm))
 
 /* Write-discard types, which should discard the write operations */
 #define P2M_DISCARD_WRITE_TYPES (p2m_to_mask(p2m_ram_ro)     \
@@ -142,8 +145,9 @@ typedef unsigned int p2m_query_t;
 #define P2M_SHARED_TYPES   (p2m_to_mask(p2m_ram_shared))
 
 /* Valid types not necessarily associated with a (valid) MFN. */
-#define P2M_INVALID_MFN_TYPES (P2M_POD_TYPES                  \
-                               | p2m_to_mask(p2m_mmio_direct) \
+#define P2M_INVALID_MFN_TYPES (P2M_POD_TYPES                    \
+                               | p2m_to_mask(p2m_mmio_direct)   \
+                               | p2m_to_mask(p2m_mmio_write_dm) \
                                | P2M_PAGING_TYPES)
 
 /* Broken type: the frame backing this pfn has failed in hardware
@@ -163,7 +167,8 @@ typedef unsigned int p2m_query_t;
    unmapped at any time and, unless you happen to be the shadow or p2m
    implementations, there's no way of synchronising against that. */
 #define p2m_is_valid(_t) (p2m_to_mask(_t) & (P2M_RAM_TYPES | P2M_MMIO_TYPES))
-#define p2m_has_emt(_t)  (p2m_to_mask(_t) & (P2M_RAM_TYPES | p2m_to_mask(p2m_mmio_direct)))
+#define p2m_has_emt(_t)  (p2m_to_mask(_t) & (P2M_RAM_TYPES | p2m_to_mask(p2m_mmio_direct) \
+                                             | p2m_to_mask(p2m_mmio_write_dm)))
 #define p2m_is_pageable(_t) (p2m_to_mask(_t) & P2M_PAGEABLE_TYPES)
 #define p2m_is_paging(_t)   (p2m_to_mask(_t) & P2M_PAGING_TYPES)
 #define p2m_is_paged(_t)    (p2m_to_mask(_t) & P2M_PAGED_TYPES)
@@ -229,6 +234,12 @@ struct p2m_domain {
     /* Alternate p2m: count of vcpu's currently using this p2m. */
     atomic_t           active_vcpus;
 
+    /* Host p2m: bumped when a gfn->mfn translation of guest memory
+     * changes. Type flips keeping the mfn (log-dirty) and MMIO remaps
+     * leave it alone. Lets toolstack gfn->mfn caches find out that they
+     * are stale (XEN_DOMCTL_gfn_to_mfn_batch). */
+    unsigned long      generation;
+
     /* Pages used to construct the p2m */
     struct page_list_head pages;
 
@@ -595,8 +606,15 @@ int p2m_is_logdirty_range(struct p2m_domain *, unsigned long start,
 /* Set mmio addresses in the p2m table (for pass-through) */
 int set_mmio_p2m_entry(struct domain *d, unsigned long gfn, mfn_t mfn,
                        unsigned int order, p2m_access_t access);
+int set_mmio_ro_p2m_entry(struct domain *d, unsigned long gfn, mfn_t mfn,
+                          unsigned int order, p2m_access_t access);
 int clear_mmio_p2m_entry(struct domain *d, unsigned long gfn, mfn_t mfn,
                          unsigned int order);
+/* Like map_mmio_regions, but writes are forwarded to the device model */
+int map_mmio_regions_ro(struct domain *d,
+                        gfn_t start_gfn,
+                        unsigned long nr,
+                        mfn_t mfn);
 
 /* Set identity addresses in the p2m table (for pass-through) */
 int set_identity_p2m_entry(struct domain *d, unsigned long gfn,
@@ -601,6 +601,8 @@ DEFINE_XEN_GUEST_HANDLE(xen_domctl_bind_pt_irq_t);
 */
 #define DPCI_ADD_MAPPING         1
 #define DPCI_REMOVE_MAPPING      0
+/* x86 only: reads go to the device, writes are forwarded to the device model */
+#define DPCI_ADD_MAPPING_RO      2
 struct xen_domctl_memory_mapping {
     uint64_aligned_t first_gfn; /* first page (hvm guest phys page) in range */
     uint64_aligned_t first_mfn; /* first page (machine page) in range */
@@ -611,6 +613,24 @@ struct xen_domctl_memory_mapping {
 typedef struct xen_domctl_memory_mapping xen_domctl_memory_mapping_t;
 DEFINE_XEN_GUEST_HANDLE(xen_domctl_memory_mapping_t);
 
+/* XEN_DOMCTL_memory_mapping_batch */
+/* Applies extents[done .. nr_extents) in order, each as one
+   XEN_DOMCTL_memory_mapping. Returns
+   - zero     with done == nr_extents, everything done
+   - zero     with done <  nr_extents, preempted or extents[done] partially
+              done (and updated in place), requiring re-invocation
+   - negative error of extents[done]
+   Errors removing an extent are ignored.
+*/
+#define XEN_DOMCTL_MEMORY_MAPPING_BATCH_MAX 1024
+struct xen_domctl_memory_mapping_batch {
+    uint32_t nr_extents;        /* IN: <= XEN_DOMCTL_MEMORY_MAPPING_BATCH_MAX */
+    uint32_t done;              /* IN/OUT: extents completed */
+    XEN_GUEST_HANDLE_64(xen_domctl_memory_mapping_t) extents;
+};
+typedef struct xen_domctl_memory_mapping_batch xen_domctl_memory_mapping_batch_t;
+DEFINE_XEN_GUEST_HANDLE(xen_domctl_memory_mapping_batch_t);
+
 
 /* Bind machine I/O port range -> HVM I/O port range. */
 /* XEN_DOMCTL_ioport_mapping */
@@ -921,6 +941,26 @@ struct xen_domctl_gfn_to_mfn {
 typedef struct xen_domctl_gfn_to_mfn xen_domctl_gfn_to_mfn_t;
 DEFINE_XEN_GUEST_HANDLE(xen_domctl_gfn_to_mfn_t);
 
+/* XEN_DOMCTL_gfn_to_mfn_batch */
+#define XEN_DOMCTL_GFN_TO_MFN_BATCH_MAX 1024
+struct xen_domctl_gfn_to_mfn_batch {
+    /* IN variables. */
+    uint32_t nr;                            /* <= XEN_DOMCTL_GFN_TO_MFN_BATCH_MAX */
+    uint32_t pad;
+    XEN_GUEST_HANDLE_64(xen_pfn_t) gfns;
+    /* OUT variables. */
+    XEN_GUEST_HANDLE_64(xen_pfn_t) mfns;
+    XEN_GUEST_HANDLE_64(int) errs;          /* 0 or -errno per entry */
+    /*
+     * p2m generation sampled before translating. It changes whenever the
+     * p2m of the domain changes, so callers caching translations compare it
+     * to drop them. nr may be 0 to only read it.
+     */
+    uint64_aligned_t generation;
+};
+typedef struct xen_domctl_gfn_to_mfn_batch xen_domctl_gfn_to_mfn_batch_t;
+DEFINE_XEN_GUEST_HANDLE(xen_domctl_gfn_to_mfn_batch_t);
+
 #if defined(__i386__) || defined(__x86_64__)
 /* XEN_DOMCTL_setvcpuextstate */
 /* XEN_DOMCTL_getvcpuextstate */
@@ -1229,6 +1269,8 @@ struct xen_domctl {
 #define XEN_DOMCTL_psr_cat_op                    78
 #define XEN_DOMCTL_soft_reset                    79
 #define XEN_DOMCTL_gfn_to_mfn                    80
+#define XEN_DOMCTL_gfn_to_mfn_batch              81
+#define XEN_DOMCTL_memory_mapping_batch          82
 #define XEN_DOMCTL_gdbsx_guestmemio            1000
 #define XEN_DOMCTL_gdbsx_pausevcpu             1001
 #define XEN_DOMCTL_gdbsx_unpausevcpu           1002
@@ -1265,6 +1307,7 @@ struct xen_domctl {
         struct xen_domctl_assign_device     assign_device;
         struct xen_domctl_bind_pt_irq       bind_pt_irq;
         struct xen_domctl_memory_mapping    memory_mapping;
+        struct xen_domctl_memory_mapping_batch memory_mapping_batch;
         struct xen_domctl_ioport_mapping    ioport_mapping;
         struct xen_domctl_pin_mem_cacheattr pin_mem_cacheattr;
         struct xen_domctl_ext_vcpucontext   ext_vcpucontext;
@@ -1282,6 +1325,7 @@ struct xen_domctl {
         struct xen_domctl_audit_p2m         audit_p2m;
         struct xen_domctl_set_virq_handler  set_virq_handler;
         struct xen_domctl_gfn_to_mfn        gfn_to_mfn;
+        struct xen_domctl_gfn_to_mfn_batch  gfn_to_mfn_batch;
         struct xen_domctl_set_max_evtchn    set_max_evtchn;
         struct xen_domctl_gdbsx_memio       gdbsx_guest_memio;
         struct xen_domctl_set_broken_page_p2m set_broken_page_p2m;
@@ -591,6 +591,7 @@ static int flask_domctl(struct domain *d, int cmd)
     case XEN_DOMCTL_irq_permission:
     case XEN_DOMCTL_iomem_permission:
     case XEN_DOMCTL_memory_mapping:
+    case XEN_DOMCTL_memory_mapping_batch:
     case XEN_DOMCTL_set_target:
     case XEN_DOMCTL_vm_event_op:
 